@@ -1,8 +1,13 @@
 ﻿#include <thread>
 #include <chrono>
+#include <iostream>
 #include "objects/OBJLoader.h"
 #include "objects/Skybox.h"
+#include "objects/Scene.h"
 #include "window/Window.h"
+#include "render/RenderPipeline.h"
+#include "render/ShadowMap.h"
+#include "render/Profiler.h"
 
 #define KEY_W 0x57
 #define KEY_S 0x53
@@ -10,6 +15,7 @@
 #define KEY_D 0x44
 #define KEY_Q 0x51
 #define KEY_E 0x45
+#define KEY_T 0x54
 
 int main() {
     Window window(800, 600, "OASIS");
@@ -21,23 +27,50 @@ int main() {
     Skybox sky(20.0f);
     Transform skyT = { {0,0,0},{0,0,0},1.0f };
     Transform monkeyT = monkey.t;
+    Scene scene;
+    Scene::ObjectId monkeyId = scene.Add(monkey.GetMesh(), monkey.GetBounds(), monkeyT, Colors::White);
+    // each frame is submitted while the one before is rasterized
+    RenderPipeline pipeline(0, true);
+    window.SetPipelined(true);
+    ShadowMap shadows(1024);
 
     window.StartRenderLoop([&]() {
-        int w = window.GetWidth();
-        int h = window.GetHeight();
-        int* fb = window.GetFramebuffer();
-        float* zb = window.GetZBuffer();
+        scene.SetTransform(monkeyId, monkeyT); // the scene belongs to this thread
+        shadows.Begin(pipeline, scene.Bounds());
+        scene.DrawDepth(pipeline);
+        shadows.End(pipeline);
 
-        std::fill(fb, fb + w * h, 0x000000);
-        std::fill(zb, zb + w * h, 1e9f);
-
-        sky.Draw(skyT, fb, zb, w, h);         // draw sky first
-        monkey.Draw(monkeyT, fb, zb, w, h, Colors::White);
+        RenderTarget frame = window.GetRenderTarget();
+        {
+            CHOMP_PROFILE_SCOPE(ProfileStage::Clear);
+            ClearDepth(frame); // the sky fills whatever stays cleared
+        }
+        pipeline.Begin(frame);
+        pipeline.SetShadowMap(shadows);
+        pipeline.SetOutline(Colors::Black, true);
+        sky.Fill(skyT, pipeline);
+        scene.Draw(pipeline);
+        pipeline.Flush();
         });
 
+    auto lastReport = std::chrono::steady_clock::now();
+    bool tracing = false;
     while (window.IsRunning()) {
         window.ProcessEvents();
 
+        if (window.verbose && std::chrono::steady_clock::now() - lastReport > std::chrono::seconds(1)) {
+            FrameStats stats = window.GetFrameStats();
+            std::cout << "frame min/avg/p99 " << stats.minMs << "/" << stats.avgMs << "/" << stats.p99Ms
+                << " ms, render " << stats.renderAvgMs << " ms, missed " << stats.missed << std::endl;
+#ifdef CHOMP_PROFILE
+            FrameProfile profile = Profiler::Get().GetLastFrame();
+            ProfileStage hot = profile.HottestStage();
+            std::cout << "hot stage " << ProfileStageName(hot) << " " << profile.stageMs[(size_t)hot] << " ms, triangles "
+                << profile.trianglesRasterized << "/" << profile.trianglesSubmitted << ", overdraw " << profile.Overdraw() << std::endl;
+#endif
+            lastReport = std::chrono::steady_clock::now();
+        }
+
         if (window.IsKeyPressed(KEY_W)) monkeyT.rotation.x += 0.05f;
         if (window.IsKeyPressed(KEY_S)) monkeyT.rotation.x -= 0.05f;
         if (window.IsKeyPressed(KEY_A)) monkeyT.rotation.y += 0.05f;
@@ -45,6 +78,19 @@ int main() {
         if (window.IsKeyPressed(KEY_Q)) monkeyT.rotation.z += 0.05f;
         if (window.IsKeyPressed(KEY_E)) monkeyT.rotation.z -= 0.05f;
 
+        // T records the next 120 frames as a Chrome trace
+        if (window.IsKeyPressed(KEY_T) && !tracing) {
+            Profiler::Get().StartCapture(120);
+            tracing = true;
+        }
+        if (tracing && !Profiler::Get().IsCapturing()) {
+            Profiler::Get().WriteTrace("chomp_trace.json");
+            std::cout << "wrote chomp_trace.json" << std::endl;
+            tracing = false;
+        }
+
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    // pipeline goes before window, so stop the render thread that draws through it
+    window.StopRenderLoop();
 }
@@ -0,0 +1,464 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <filesystem>
+#include "../objects/Cube.h"
+#include "../objects/Skybox.h"
+#include "../objects/Scene.h"
+#include "../objects/OBJLoader.h"
+#include "../objects/Shading.h"
+#include "../render/RenderPipeline.h"
+#include "../render/Profiler.h"
+#include "../render/Texture.h"
+
+// Renders fixed scenes without a window for a number of frames each and writes
+// their timings and throughput as JSON. A frame is what the render loop does:
+// clear depth, Begin, submit the scene, Flush, and with --layout tiled resolve the
+// frame to rows as a present would. With CHOMP_PROFILE each scene also gets the
+// profiler's mean time per stage. With --pipelined frames alternate between two
+// targets and a frame is rasterized while the next is submitted, so its time is
+// the throughput the render loop would see.
+
+#ifndef CHOMP_MODELS_DIR
+#define CHOMP_MODELS_DIR "models"
+#endif
+
+namespace {
+
+struct Options {
+    int frames = 100;
+    int warmup = 10;
+    int width = 1280, height = 720;
+    unsigned threads = 0;  // every hardware thread
+    std::string scene;     // all scenes when empty
+    std::string kettle = CHOMP_MODELS_DIR "/Kettle.obj";
+    std::string out;       // stdout when empty
+    std::string trace;     // Chrome trace of every frame, when set and CHOMP_PROFILE is on
+    TargetLayout layout = TargetLayout::Linear;
+    bool pipelined = false;
+};
+
+struct BenchScene {
+    std::string name;
+    Camera camera;
+    std::function<void(RenderPipeline&, int)> draw; // submits frame i between Begin and Flush
+    std::string skipped; // why the scene cannot run; empty when it can
+
+    BenchScene(std::string name, Camera camera, std::function<void(RenderPipeline&, int)> draw)
+        : name(std::move(name)), camera(camera), draw(std::move(draw)) {}
+};
+
+struct SceneResult {
+    std::string name;
+    std::string skipped;
+    std::vector<double> frameMs;
+    uint64_t triangles = 0;  // CullStats::triangles, summed over the timed frames
+    uint64_t rasterized = 0;
+    uint64_t pixelsTested = 0;
+    uint64_t pixelsWritten = 0;
+    uint64_t covered = 0;    // pixels written at least once
+    double stageMs[(size_t)ProfileStage::Count] = {}; // profiler self times, summed
+};
+
+// Top byte of an XRGB8888 pixel, which no color write sets: marks pixels the frame left alone
+const uint32_t Untouched = 0xFF000000u;
+
+Camera BenchCamera() {
+    return Camera::Perspective(1.0f);
+}
+
+// Unit cube as 8 shared corners (bit 0 x, bit 1 y, bit 2 z), wound like Cube's faces
+Mesh BoxMesh() {
+    Mesh m;
+    for (int i = 0; i < 8; i++)
+        m.vertices.Add({ (i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f });
+    const uint32_t faces[12][3] = { {4,5,7},{4,7,6}, {0,3,1},{0,2,3}, {0,4,6},{0,6,2},
+        {1,7,5},{1,3,7}, {2,6,7},{2,7,3}, {0,5,4},{0,1,5} };
+    for (const auto& f : faces) m.AddTriangle(f[0], f[1], f[2]);
+    return m;
+}
+
+// Rippled torus of rings * segments quads, two triangles each
+Mesh TorusMesh(uint32_t rings, uint32_t segments) {
+    const float Pi = 3.14159265f;
+    const float R = 1.0f, r = 0.4f;
+    Mesh m;
+    for (uint32_t i = 0; i < rings; i++) {
+        float u = 2 * Pi * i / rings;
+        for (uint32_t j = 0; j < segments; j++) {
+            float v = 2 * Pi * j / segments;
+            float tube = r * (1.0f + 0.05f * std::sin(16 * u) * std::sin(12 * v));
+            float d = R + tube * std::cos(v);
+            m.vertices.Add({ d * std::cos(u), tube * std::sin(v), d * std::sin(u) });
+        }
+    }
+    for (uint32_t i = 0; i < rings; i++) {
+        uint32_t i1 = (i + 1) % rings;
+        for (uint32_t j = 0; j < segments; j++) {
+            uint32_t j1 = (j + 1) % segments;
+            uint32_t a = i * segments + j, b = i * segments + j1;
+            uint32_t c = i1 * segments + j, d = i1 * segments + j1;
+            m.AddTriangle(a, d, c);
+            m.AddTriangle(a, b, d);
+        }
+    }
+    return m;
+}
+
+BenchScene CubeScene() {
+    auto cube = std::make_shared<Cube>(1.0f);
+    return { "cube", BenchCamera(), [cube](RenderPipeline& pipeline, int i) {
+        cube->Draw(Colors::Red, { {0,0,3}, {0.4f + i * 0.01f, i * 0.02f, 0}, 1.0f }, pipeline);
+    } };
+}
+
+// 10x10x10 spinning cubes through Scene, so the BVH refit and walk are part of the frame
+BenchScene CubeGridScene() {
+    struct State {
+        Mesh box = BoxMesh();
+        Scene scene;
+        std::vector<Transform> transforms;
+    };
+    auto s = std::make_shared<State>();
+    for (int z = 0; z < 10; z++)
+        for (int y = 0; y < 10; y++)
+            for (int x = 0; x < 10; x++) {
+                Transform t = { {(x - 4.5f) * 2, (y - 4.5f) * 2, 32 + (z - 4.5f) * 2}, {0,0,0}, 1.0f };
+                s->transforms.push_back(t);
+                s->scene.Add(s->box.View(), t, { (unsigned char)(x * 25), (unsigned char)(y * 25), (unsigned char)(z * 25) });
+            }
+    return { "cubes_1k", BenchCamera(), [s](RenderPipeline& pipeline, int i) {
+        for (Scene::ObjectId id = 0; id < s->transforms.size(); id++) {
+            Transform t = s->transforms[id];
+            t.rotation = { i * 0.02f + id, i * 0.03f, 0 };
+            s->scene.SetTransform(id, t);
+        }
+        s->scene.Draw(pipeline);
+    } };
+}
+
+BenchScene KettleScene(const std::string& path) {
+    BenchScene bench = { "kettle", BenchCamera(), nullptr };
+    if (!std::filesystem::exists(path)) {
+        bench.skipped = "not found: " + path;
+        return bench;
+    }
+    auto kettle = std::make_shared<OBJLoader>(path);
+    if (kettle->GetMesh().indexCount == 0) {
+        bench.skipped = "no triangles in " + path;
+        return bench;
+    }
+    // fit the model's bounding sphere to a unit sphere three units ahead
+    const BoundingSphere& b = kettle->GetBounds();
+    float scale = b.radius > 0 ? 1.0f / b.radius : 1.0f;
+    bench.draw = [kettle, b, scale](RenderPipeline& pipeline, int i) {
+        Vec3 center = b.center * scale;
+        kettle->Draw({ Vec3{ 0,0,3 } - center, {0.3f, i * 0.02f, 0}, scale }, pipeline, Colors::White);
+    };
+    return bench;
+}
+
+// Sky cubes drawn one over another without depth: every layer colors every pixel.
+// Under the window's default orthographic camera, as the app draws them; from
+// inside a cube all its faces would be culled as back-facing.
+BenchScene SkyboxStackScene() {
+    const int Layers = 8;
+    auto sky = std::make_shared<Skybox>(20.0f);
+    return { "skybox_stack", Camera::Orthographic(), [sky](RenderPipeline& pipeline, int i) {
+        for (int layer = 0; layer < Layers; layer++)
+            sky->Draw({ {0,0,0}, {0, i * 0.01f + layer * 0.3f, 0}, 1.0f }, pipeline);
+    } };
+}
+
+// One million triangles in a single draw, without LODs
+BenchScene MillionScene() {
+    struct State {
+        Mesh mesh;
+        ShadeScratch shading;
+    };
+    auto s = std::make_shared<State>();
+    s->mesh = TorusMesh(500, 1000);
+    s->mesh.OptimizeVertexCache();
+    s->mesh.ComputeNormals();
+    return { "mesh_1m", BenchCamera(), [s](RenderPipeline& pipeline, int i) {
+        Mat4 model = Mat4::FromTransform({ {0,0,3.5f}, {0.8f, i * 0.02f, 0}, 1.0f });
+        DrawShaded(pipeline, s->mesh.View(), model, Colors::Green, s->shading);
+    } };
+}
+
+// Plain torus with texture coordinates; the seams where u and v wrap get a
+// second row and column of vertices, so rings + 1 by segments + 1 of them
+Mesh TexturedTorusMesh(uint32_t rings, uint32_t segments) {
+    const float Pi = 3.14159265f;
+    const float R = 1.0f, r = 0.4f;
+    Mesh m;
+    for (uint32_t i = 0; i <= rings; i++) {
+        float u = 2 * Pi * i / rings;
+        for (uint32_t j = 0; j <= segments; j++) {
+            float v = 2 * Pi * j / segments;
+            float d = R + r * std::cos(v);
+            m.vertices.Add({ d * std::cos(u), r * std::sin(v), d * std::sin(u) });
+            m.texU.push_back(4.0f * i / rings); // repeated around the ring
+            m.texV.push_back(1.0f * j / segments);
+        }
+    }
+    for (uint32_t i = 0; i < rings; i++) {
+        for (uint32_t j = 0; j < segments; j++) {
+            uint32_t a = i * (segments + 1) + j, b = a + 1;
+            uint32_t c = a + segments + 1, d = c + 1;
+            m.AddTriangle(a, d, c);
+            m.AddTriangle(a, b, d);
+        }
+    }
+    return m;
+}
+
+// 256x256 checkerboard with a color gradient, so every mip level differs
+Texture CheckerTexture() {
+    const int Size = 256;
+    std::vector<uint8_t> rgb(Size * Size * 3);
+    for (int y = 0; y < Size; y++)
+        for (int x = 0; x < Size; x++) {
+            uint8_t* p = &rgb[(y * Size + x) * 3];
+            bool light = ((x >> 4) ^ (y >> 4)) & 1;
+            p[0] = light ? 255 : (uint8_t)x;
+            p[1] = light ? 255 : (uint8_t)y;
+            p[2] = light ? 160 : 40;
+        }
+    return Texture(rgb.data(), Size, Size);
+}
+
+// A textured, lit torus filling most of the screen at a slant, so triangles
+// sample several mip levels
+BenchScene TexturedScene() {
+    struct State {
+        Mesh mesh;
+        Texture texture;
+        ShadeScratch shading;
+    };
+    auto s = std::make_shared<State>();
+    s->mesh = TexturedTorusMesh(200, 100);
+    s->mesh.OptimizeVertexCache();
+    s->mesh.ComputeNormals();
+    s->texture = CheckerTexture();
+    return { "textured", BenchCamera(), [s](RenderPipeline& pipeline, int i) {
+        Mat4 model = Mat4::FromTransform({ {0,0,2.2f}, {0.9f, i * 0.02f, 0}, 1.0f });
+        DrawShaded(pipeline, s->mesh.View(), model, Colors::White, s->shading, s->texture.Raster());
+    } };
+}
+
+SceneResult Run(const BenchScene& bench, RenderPipeline& pipeline, const Options& options) {
+    SceneResult result;
+    result.name = bench.name;
+    result.skipped = bench.skipped;
+    if (!bench.skipped.empty()) return result;
+
+    size_t pixels = (size_t)options.width * options.height;
+    size_t planePixels = PlanePixels(options.width, options.height, options.layout);
+    const int targetCount = options.pipelined ? 2 : 1;
+    std::vector<uint32_t> color[2];
+    std::vector<float> depth[2];
+    RenderTarget targets[2];
+    for (int t = 0; t < targetCount; t++) {
+        color[t].resize(planePixels);
+        depth[t].resize(planePixels);
+        targets[t] = { color[t].data(), depth[t].data(), options.width, options.height,
+            ColorFormat::XRGB8888, DepthFormat::Float32, options.layout };
+    }
+    std::vector<uint32_t> resolved(options.layout == TargetLayout::Tiled ? pixels : 0);
+    pipeline.camera = bench.camera;
+
+    // pixels and coverage of frame f, counted once it is drawn
+    auto countDrawn = [&](int f, const RasterStats& raster) {
+        if (f < options.warmup) return;
+        const std::vector<uint32_t>& drawn = color[f % targetCount];
+        result.pixelsTested += raster.pixelsTested;
+        result.pixelsWritten += raster.pixelsWritten;
+        result.covered += planePixels - std::count(drawn.begin(), drawn.end(), Untouched);
+    };
+    auto resolve = [&](int f) {
+        CHOMP_PROFILE_SCOPE(ProfileStage::Present);
+        ResolveColor(targets[f % targetCount], resolved.data(), options.width, 0, options.height);
+    };
+
+    const int frameCount = options.warmup + options.frames;
+    for (int i = 0; i < frameCount; i++) {
+        int t = i % targetCount;
+        std::fill(color[t].begin(), color[t].end(), Untouched);
+
+        auto start = std::chrono::steady_clock::now();
+        CHOMP_PROFILE_BEGIN_FRAME();
+        {
+            CHOMP_PROFILE_SCOPE(ProfileStage::Clear);
+            ClearDepth(targets[t]);
+        }
+        pipeline.Begin(targets[t]);
+        bench.draw(pipeline, i);
+        pipeline.Flush();
+        // pipelined, Flush has drawn the frame before, and the last one is waited for
+        bool last = i + 1 == frameCount;
+        if (options.pipelined && last) pipeline.Finish();
+        if (!resolved.empty()) {
+            if (options.pipelined && i > 0) resolve(i - 1);
+            if (!options.pipelined || last) resolve(i);
+        }
+        CHOMP_PROFILE_END_FRAME();
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+
+        if (options.pipelined && i > 0) countDrawn(i - 1, pipeline.GetRasterStats(true));
+        if (!options.pipelined || last) countDrawn(i, pipeline.GetRasterStats());
+        if (i < options.warmup) continue;
+        result.frameMs.push_back(ms.count());
+        const CullStats& cull = pipeline.GetCullStats();
+        result.triangles += cull.triangles;
+        result.rasterized += cull.rasterized;
+        FrameProfile profile = Profiler::Get().GetLastFrame();
+        for (size_t s = 0; s < (size_t)ProfileStage::Count; s++) result.stageMs[s] += profile.stageMs[s];
+    }
+    return result;
+}
+
+std::string Escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c < 0x20) out += ' ';
+        else out += c;
+    }
+    return out;
+}
+
+void WriteJson(FILE* f, const std::vector<SceneResult>& results, const Options& options, unsigned threads) {
+    std::fprintf(f, "{\n  \"isa\": \"%s\",\n  \"threads\": %u,\n  \"width\": %d,\n  \"height\": %d,\n"
+        "  \"layout\": \"%s\",\n  \"pipelined\": %s,\n  \"frames\": %d,\n  \"warmup\": %d,\n  \"scenes\": [",
+        GetRasterIsaName(), threads, options.width, options.height,
+        options.layout == TargetLayout::Tiled ? "tiled" : "linear", options.pipelined ? "true" : "false",
+        options.frames, options.warmup);
+    for (size_t i = 0; i < results.size(); i++) {
+        const SceneResult& r = results[i];
+        std::fprintf(f, "%s\n    {\"name\": \"%s\"", i ? "," : "", r.name.c_str());
+        if (!r.skipped.empty()) {
+            std::fprintf(f, ", \"skipped\": \"%s\"}", Escape(r.skipped).c_str());
+            continue;
+        }
+        std::vector<double> sorted = r.frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (double ms : sorted) total += ms;
+        double n = (double)sorted.size();
+        double seconds = total / 1000.0;
+        std::fprintf(f, ",\n     \"ms_per_frame\": %.4f, \"ms_min\": %.4f, \"ms_median\": %.4f, \"ms_p95\": %.4f, \"ms_max\": %.4f,\n",
+            total / n, sorted.front(), sorted[sorted.size() / 2], sorted[(size_t)((n - 1) * 0.95)], sorted.back());
+        std::fprintf(f, "     \"triangles_per_frame\": %.1f, \"rasterized_per_frame\": %.1f, \"triangles_per_sec\": %.0f,\n",
+            r.triangles / n, r.rasterized / n, r.triangles / seconds);
+        std::fprintf(f, "     \"pixels_per_sec\": %.0f, \"pixels_tested_per_sec\": %.0f, \"coverage\": %.4f, \"overdraw\": %.4f",
+            r.pixelsWritten / seconds, r.pixelsTested / seconds,
+            r.covered / (n * options.width * options.height),
+            r.covered ? (double)r.pixelsWritten / r.covered : 0.0);
+#ifdef CHOMP_PROFILE
+        std::fprintf(f, ",\n     \"stages_ms\": {");
+        for (size_t s = 0; s < (size_t)ProfileStage::Count; s++)
+            std::fprintf(f, "%s\"%s\": %.4f", s ? ", " : "", ProfileStageName((ProfileStage)s), r.stageMs[s] / n);
+        std::fprintf(f, "}");
+#endif
+        std::fprintf(f, "}");
+    }
+    std::fprintf(f, "\n  ]\n}\n");
+}
+
+void Usage() {
+    std::fprintf(stderr, "usage: chomp_bench [--frames N] [--warmup N] [--width W] [--height H] [--threads T]\n"
+        "                   [--scene cube|cubes_1k|kettle|skybox_stack|mesh_1m|textured] [--kettle PATH] [--out FILE]\n"
+        "                   [--trace FILE] [--layout linear|tiled] [--pipelined on|off]\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (arg == "--frames") options.frames = std::atoi(value);
+        else if (arg == "--warmup") options.warmup = std::atoi(value);
+        else if (arg == "--width") options.width = std::atoi(value);
+        else if (arg == "--height") options.height = std::atoi(value);
+        else if (arg == "--threads") options.threads = (unsigned)std::atoi(value);
+        else if (arg == "--scene") options.scene = value;
+        else if (arg == "--kettle") options.kettle = value;
+        else if (arg == "--out") options.out = value;
+        else if (arg == "--trace") options.trace = value;
+        else if (arg == "--layout") {
+            if (std::strcmp(value, "tiled") == 0) options.layout = TargetLayout::Tiled;
+            else if (std::strcmp(value, "linear") != 0) return false;
+        }
+        else if (arg == "--pipelined") {
+            if (std::strcmp(value, "on") == 0) options.pipelined = true;
+            else if (std::strcmp(value, "off") != 0) return false;
+        }
+        else return false;
+    }
+    return options.frames > 0 && options.warmup >= 0 && options.width > 0 && options.height > 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        Usage();
+        return 1;
+    }
+
+    // scenes are built lazily, so --scene skips the setup of the others
+    std::vector<std::pair<const char*, std::function<BenchScene()>>> scenes = {
+        { "cube", CubeScene },
+        { "cubes_1k", CubeGridScene },
+        { "kettle", [&] { return KettleScene(options.kettle); } },
+        { "skybox_stack", SkyboxStackScene },
+        { "mesh_1m", MillionScene },
+        { "textured", TexturedScene },
+    };
+    if (!options.scene.empty() && std::none_of(scenes.begin(), scenes.end(),
+        [&](const auto& s) { return options.scene == s.first; })) {
+        Usage();
+        return 1;
+    }
+
+    RenderPipeline pipeline(options.threads, options.pipelined);
+    std::vector<SceneResult> results;
+    if (!options.trace.empty()) Profiler::Get().StartCapture(UINT32_MAX);
+    for (const auto& [name, make] : scenes) {
+        if (!options.scene.empty() && options.scene != name) continue;
+        results.push_back(Run(make(), pipeline, options));
+        const SceneResult& r = results.back();
+        if (r.skipped.empty()) {
+            double total = 0;
+            for (double ms : r.frameMs) total += ms;
+            std::fprintf(stderr, "%-14s %8.3f ms/frame\n", name, total / r.frameMs.size());
+        }
+        else {
+            std::fprintf(stderr, "%-14s skipped (%s)\n", name, r.skipped.c_str());
+        }
+    }
+
+    FILE* out = stdout;
+    if (!options.out.empty() && !(out = std::fopen(options.out.c_str(), "w"))) {
+        std::fprintf(stderr, "cannot write %s\n", options.out.c_str());
+        return 1;
+    }
+    WriteJson(out, results, options, pipeline.GetThreadCount());
+    if (out != stdout) std::fclose(out);
+    if (!options.trace.empty() && !Profiler::Get().WriteTrace(options.trace)) {
+        std::fprintf(stderr, "cannot write %s\n", options.trace.c_str());
+        return 1;
+    }
+    return 0;
+}
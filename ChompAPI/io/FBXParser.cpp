@@ -0,0 +1,382 @@
+#include "FBXParser.h"
+#include "Inflate.h"
+#include "MappedFile.h"
+#include "../objects/Mesh.h"
+#include "../render/ThreadPool.h"
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <type_traits>
+
+static const char Magic[] = "Kaydara FBX Binary  ";
+static const size_t HeaderBytes = 27; // magic + NUL, 0x1A 0x00, uint32 version
+
+namespace {
+
+template <typename T>
+T Load(const uint8_t* p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+size_t ElementSize(char type)
+{
+    switch (type) {
+    case 'd': case 'l': return 8;
+    case 'f': case 'i': return 4;
+    case 'b': return 1;
+    default: return 0;
+    }
+}
+
+// Bytes taken by a property's payload, 0 if it does not fit in the given space
+size_t PropertyBytes(char type, const uint8_t* p, size_t space)
+{
+    size_t need;
+    switch (type) {
+    case 'C': need = 1; break;
+    case 'Y': need = 2; break;
+    case 'I': case 'F': need = 4; break;
+    case 'D': case 'L': need = 8; break;
+    case 'S': case 'R':
+        if (space < 4) return 0;
+        need = 4 + (size_t)Load<uint32_t>(p);
+        break;
+    default:
+        if (!ElementSize(type) || space < 12) return 0;
+        need = 12 + (size_t)Load<uint32_t>(p + 8);
+        break;
+    }
+    return need <= space ? need : 0;
+}
+
+template <typename Src, typename Dst>
+void Convert(const uint8_t* raw, size_t count, Dst* out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = (Dst)Load<Src>(raw + i * sizeof(Src));
+}
+
+template <typename T>
+bool ReadArrayAs(char type, const uint8_t* data, size_t size, std::vector<T>& out)
+{
+    size_t elem = ElementSize(type);
+    if (!elem || size < 12) return false;
+    uint32_t length = Load<uint32_t>(data);
+    uint32_t encoding = Load<uint32_t>(data + 4);
+    uint32_t bytes = Load<uint32_t>(data + 8);
+    const uint8_t* payload = data + 12;
+    size_t rawBytes = (size_t)length * elem;
+    if (bytes > size - 12 || encoding > 1 || (encoding == 0 && bytes != rawBytes)) return false;
+
+    out.resize(length);
+    bool sameType = elem == sizeof(T) && ((type == 'd' && std::is_same_v<T, double>) ||
+        (type == 'f' && std::is_same_v<T, float>) || (type == 'i' && std::is_same_v<T, int32_t>));
+    if (sameType) {
+        if (encoding == 1) return InflateZlib(payload, bytes, (uint8_t*)out.data(), rawBytes);
+        if (rawBytes) std::memcpy(out.data(), payload, rawBytes);
+        return true;
+    }
+
+    std::vector<uint8_t> scratch;
+    const uint8_t* raw = payload;
+    if (encoding == 1) {
+        scratch.resize(rawBytes);
+        if (!InflateZlib(payload, bytes, scratch.data(), rawBytes)) return false;
+        raw = scratch.data();
+    }
+    switch (type) {
+    case 'd': Convert<double>(raw, length, out.data()); break;
+    case 'f': Convert<float>(raw, length, out.data()); break;
+    case 'l': Convert<int64_t>(raw, length, out.data()); break;
+    case 'i': Convert<int32_t>(raw, length, out.data()); break;
+    case 'b': Convert<uint8_t>(raw, length, out.data()); break;
+    }
+    return true;
+}
+
+} // namespace
+
+int64_t FBXProperty::AsInt() const
+{
+    switch (type) {
+    case 'C': return data[0];
+    case 'Y': return Load<int16_t>(data);
+    case 'I': return Load<int32_t>(data);
+    case 'L': return Load<int64_t>(data);
+    case 'F': return (int64_t)Load<float>(data);
+    case 'D': return (int64_t)Load<double>(data);
+    default: return 0;
+    }
+}
+
+double FBXProperty::AsDouble() const
+{
+    switch (type) {
+    case 'F': return Load<float>(data);
+    case 'D': return Load<double>(data);
+    default: return (double)AsInt();
+    }
+}
+
+std::string_view FBXProperty::AsString() const
+{
+    if (type != 'S' && type != 'R') return {};
+    return { (const char*)data + 4, size - 4 };
+}
+
+uint32_t FBXProperty::ArrayLength() const
+{
+    return IsArray() ? Load<uint32_t>(data) : 0;
+}
+
+bool FBXProperty::ReadArray(std::vector<double>& out) const { return ReadArrayAs(type, data, size, out); }
+bool FBXProperty::ReadArray(std::vector<float>& out) const { return ReadArrayAs(type, data, size, out); }
+bool FBXProperty::ReadArray(std::vector<int32_t>& out) const { return ReadArrayAs(type, data, size, out); }
+
+FBXNode FBXNode::Parse(const FBXDocument* doc, const uint8_t* p, const uint8_t* limit)
+{
+    FBXNode node;
+    const size_t header = doc->wideRecords ? 25 : 13;
+    if (p < doc->base || p > limit || (size_t)(limit - p) < header) return node;
+
+    uint64_t endOffset, count, bytes;
+    if (doc->wideRecords) {
+        endOffset = Load<uint64_t>(p);
+        count = Load<uint64_t>(p + 8);
+        bytes = Load<uint64_t>(p + 16);
+    }
+    else {
+        endOffset = Load<uint32_t>(p);
+        count = Load<uint32_t>(p + 4);
+        bytes = Load<uint32_t>(p + 8);
+    }
+    uint8_t nameLength = p[header - 1];
+    if (endOffset == 0) return node; // null record closes the list
+
+    const uint8_t* end = doc->base + endOffset;
+    const uint8_t* properties = p + header + nameLength;
+    if (endOffset > doc->size || end > limit || end < properties || bytes > (uint64_t)(end - properties) || count > bytes)
+        return node;
+
+    node.doc = doc;
+    node.end = end;
+    node.limit = limit;
+    node.name = { (const char*)p + header, nameLength };
+    node.propertyCount = (uint32_t)count;
+    node.properties = properties;
+    node.propertyBytes = (size_t)bytes;
+    node.children = properties + bytes;
+    return node;
+}
+
+FBXProperty FBXNode::Property(uint32_t i) const
+{
+    FBXProperty prop;
+    if (i >= propertyCount) return prop;
+    const uint8_t* p = properties;
+    const uint8_t* stop = properties + propertyBytes;
+    for (uint32_t k = 0;; k++) {
+        if (p >= stop) return prop;
+        char type = (char)*p++;
+        size_t bytes = PropertyBytes(type, p, (size_t)(stop - p));
+        if (!bytes) return prop;
+        if (k == i) {
+            prop.type = type;
+            prop.data = p;
+            prop.size = bytes;
+            return prop;
+        }
+        p += bytes;
+    }
+}
+
+FBXNode FBXNode::FirstChild() const
+{
+    return IsValid() ? Parse(doc, children, end) : FBXNode();
+}
+
+FBXNode FBXNode::Next() const
+{
+    return IsValid() ? Parse(doc, end, limit) : FBXNode();
+}
+
+FBXNode FBXNode::Child(std::string_view childName) const
+{
+    for (FBXNode c = FirstChild(); c.IsValid(); c = c.Next())
+        if (c.Name() == childName) return c;
+    return FBXNode();
+}
+
+bool FBXDocument::Open(const char* data, size_t dataSize)
+{
+    base = nullptr;
+    size = 0;
+    if (dataSize < HeaderBytes || std::memcmp(data, Magic, sizeof(Magic)) != 0) return false;
+    version = Load<uint32_t>((const uint8_t*)data + 23);
+    if (version < 7000 || version >= 8000) return false;
+    base = (const uint8_t*)data;
+    size = dataSize;
+    wideRecords = version >= 7500;
+    return true;
+}
+
+FBXNode FBXDocument::FirstNode() const
+{
+    return base ? FBXNode::Parse(this, base + HeaderBytes, base + size) : FBXNode();
+}
+
+FBXNode FBXDocument::Find(std::string_view name) const
+{
+    for (FBXNode n = FirstNode(); n.IsValid(); n = n.Next())
+        if (n.Name() == name) return n;
+    return FBXNode();
+}
+
+namespace {
+
+const float DegToRad = 3.14159265358979f / 180.0f;
+
+struct Model {
+    Mat4 local = Mat4::Identity();
+    int64_t parent = 0;
+};
+
+struct Geometry {
+    FBXNode node;
+    int64_t model = 0;
+    // decoded on a worker
+    std::vector<double> positions;
+    std::vector<int32_t> polygons;
+    bool ok = false;
+};
+
+Vec3 ReadVector(const FBXNode& p)
+{
+    return { (float)p.Property(4).AsDouble(), (float)p.Property(5).AsDouble(), (float)p.Property(6).AsDouble() };
+}
+
+Mat4 Rotation(const Vec3& degrees)
+{
+    Transform t;
+    t.rotation = { degrees.x * DegToRad, degrees.y * DegToRad, degrees.z * DegToRad };
+    t.scale = 1.0f;
+    t.pos = { 0, 0, 0 };
+    return Mat4::FromTransform(t); // X, then Y, then Z: FBX's default XYZ order
+}
+
+// T * PreRotation * R * S from the model's Properties70; pivots and offsets are ignored
+Mat4 LocalMatrix(const FBXNode& model)
+{
+    Vec3 translation = { 0, 0, 0 }, preRotation = { 0, 0, 0 }, rotation = { 0, 0, 0 }, scaling = { 1, 1, 1 };
+    for (FBXNode p = model.Child("Properties70").FirstChild(); p.IsValid(); p = p.Next()) {
+        std::string_view name = p.Property(0).AsString();
+        if (name == "Lcl Translation") translation = ReadVector(p);
+        else if (name == "Lcl Rotation") rotation = ReadVector(p);
+        else if (name == "Lcl Scaling") scaling = ReadVector(p);
+        else if (name == "PreRotation") preRotation = ReadVector(p);
+    }
+    Mat4 scale = Mat4::Identity();
+    scale.m[0][0] = scaling.x; scale.m[1][1] = scaling.y; scale.m[2][2] = scaling.z;
+    Mat4 m = Rotation(preRotation) * Rotation(rotation) * scale;
+    m.m[0][3] = translation.x; m.m[1][3] = translation.y; m.m[2][3] = translation.z;
+    return m;
+}
+
+Mat4 WorldMatrix(const std::unordered_map<int64_t, Model>& models, int64_t id)
+{
+    Mat4 world = Mat4::Identity();
+    for (int depth = 0; depth < 256; depth++) { // bounded in case of a cyclic file
+        auto it = models.find(id);
+        if (it == models.end()) break;
+        world = it->second.local * world;
+        id = it->second.parent;
+    }
+    return world;
+}
+
+} // namespace
+
+bool LoadFBX(const char* data, size_t size, Mesh& out, ThreadPool& pool)
+{
+    out = Mesh();
+    FBXDocument doc;
+    if (!doc.Open(data, size)) return false;
+
+    std::unordered_map<int64_t, Model> models;
+    std::unordered_map<int64_t, size_t> geometryIds;
+    std::vector<Geometry> geometries;
+    for (FBXNode n = doc.Find("Objects").FirstChild(); n.IsValid(); n = n.Next()) {
+        if (n.Name() == "Model") {
+            models[n.Property(0).AsInt()].local = LocalMatrix(n);
+        }
+        else if (n.Name() == "Geometry" && n.Property(2).AsString() == "Mesh") {
+            geometryIds[n.Property(0).AsInt()] = geometries.size();
+            Geometry& g = geometries.emplace_back();
+            g.node = n;
+        }
+    }
+
+    // object-object links: child id, parent id
+    for (FBXNode c = doc.Find("Connections").FirstChild(); c.IsValid(); c = c.Next()) {
+        if (c.Name() != "C" || c.Property(0).AsString() != "OO") continue;
+        int64_t child = c.Property(1).AsInt(), parent = c.Property(2).AsInt();
+        if (!models.count(parent)) continue;
+        auto model = models.find(child);
+        auto geometry = geometryIds.find(child);
+        if (model != models.end()) model->second.parent = parent;
+        else if (geometry != geometryIds.end()) geometries[geometry->second].model = parent;
+    }
+
+    // the compressed arrays are independent, so inflate them in parallel
+    pool.ParallelFor((int)geometries.size(), [&](int i) {
+        Geometry& g = geometries[i];
+        g.ok = g.node.Child("Vertices").Property(0).ReadArray(g.positions) &&
+            g.node.Child("PolygonVertexIndex").Property(0).ReadArray(g.polygons);
+        });
+
+    for (Geometry& g : geometries) {
+        if (!g.ok) continue;
+        Mat4 world = WorldMatrix(models, g.model);
+        const uint32_t base = (uint32_t)out.vertices.Size();
+        const size_t count = g.positions.size() / 3;
+        for (size_t i = 0; i < count; i++) {
+            Vec3 v = { (float)g.positions[i * 3], (float)g.positions[i * 3 + 1], (float)g.positions[i * 3 + 2] };
+            out.vertices.Add(world.TransformPoint(v));
+        }
+
+        // a negative index (stored as ~index) closes each polygon
+        size_t first = 0;
+        for (size_t i = 0; i < g.polygons.size(); i++) {
+            if (g.polygons[i] >= 0) continue;
+            int32_t a = g.polygons[first];
+            bool valid = true;
+            for (size_t k = first; k <= i; k++) {
+                int32_t v = k == i ? ~g.polygons[k] : g.polygons[k];
+                valid = valid && v >= 0 && (size_t)v < count;
+            }
+            if (valid) {
+                for (size_t k = first + 1; k + 1 <= i; k++) {
+                    int32_t b = g.polygons[k], c = k + 1 == i ? ~g.polygons[i] : g.polygons[k + 1];
+                    out.AddTriangle(base + a, base + b, base + c);
+                }
+            }
+            first = i + 1;
+        }
+    }
+    return true;
+}
+
+bool LoadFBX(const std::string& path, Mesh& out, ThreadPool* pool)
+{
+    MappedFile file;
+    if (!file.Open(path)) return false;
+
+    std::unique_ptr<ThreadPool> ownPool;
+    if (!pool) {
+        ownPool = std::make_unique<ThreadPool>();
+        pool = ownPool.get();
+    }
+    return LoadFBX(file.Data(), file.Size(), out, *pool);
+}
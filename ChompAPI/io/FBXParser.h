@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct Mesh;
+class ThreadPool;
+class FBXDocument;
+
+// One property of a node, pointing into the file
+class FBXProperty {
+public:
+    char Type() const { return type; } // FBX type code, 0 if missing
+    bool IsArray() const { return type == 'f' || type == 'd' || type == 'l' || type == 'i' || type == 'b'; }
+
+    int64_t AsInt() const;             // Y, C, I, L
+    double AsDouble() const;           // F, D or any integer type
+    std::string_view AsString() const; // S, R
+
+    uint32_t ArrayLength() const;
+    // Decodes an array property, inflating it straight into out when it is
+    // compressed, and converts the elements. False if this is not an array or
+    // the data is corrupt.
+    bool ReadArray(std::vector<double>& out) const;
+    bool ReadArray(std::vector<float>& out) const;
+    bool ReadArray(std::vector<int32_t>& out) const;
+
+private:
+    friend class FBXNode;
+    char type = 0;
+    const uint8_t* data = nullptr; // payload after the type code
+    size_t size = 0;
+};
+
+// A node record. Children and properties are decoded only when asked for;
+// an invalid node marks the end of a list.
+class FBXNode {
+public:
+    bool IsValid() const { return doc != nullptr; }
+    std::string_view Name() const { return name; }
+
+    uint32_t PropertyCount() const { return propertyCount; }
+    FBXProperty Property(uint32_t i) const;
+
+    FBXNode FirstChild() const;
+    FBXNode Next() const;
+    FBXNode Child(std::string_view childName) const; // first child with this name
+
+private:
+    friend class FBXDocument;
+    const FBXDocument* doc = nullptr;
+    const uint8_t* end = nullptr;   // one past this record
+    const uint8_t* limit = nullptr; // end of the enclosing list
+    std::string_view name;
+    uint32_t propertyCount = 0;
+    const uint8_t* properties = nullptr;
+    size_t propertyBytes = 0;
+    const uint8_t* children = nullptr;
+
+    static FBXNode Parse(const FBXDocument* doc, const uint8_t* p, const uint8_t* limit);
+};
+
+// Binary FBX (versions 7100-7700) held in memory by the caller, usually a MappedFile
+class FBXDocument {
+public:
+    bool Open(const char* data, size_t size); // false if this is not binary FBX
+    uint32_t Version() const { return version; }
+
+    FBXNode FirstNode() const;
+    FBXNode Find(std::string_view name) const; // top-level node
+
+private:
+    friend class FBXNode;
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    uint32_t version = 0;
+    bool wideRecords = false; // 7500+ uses 64-bit record headers
+};
+
+// Reads every Objects/Geometry mesh, bakes the Lcl translation/rotation/scaling
+// of its model and that model's parents into the positions, and appends
+// fan-triangulated faces to out. Axis and unit conversion are left to the
+// caller's Transform. Returns false if the data is not a readable binary FBX.
+bool LoadFBX(const char* data, size_t size, Mesh& out, ThreadPool& pool);
+
+// Same, over a memory-mapped file; a null pool decodes on a temporary one
+bool LoadFBX(const std::string& path, Mesh& out, ThreadPool* pool = nullptr);
@@ -0,0 +1,189 @@
+#include "Image.h"
+#include "MappedFile.h"
+#include "Inflate.h"
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+
+const uint8_t PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+// larger images are refused rather than allocated
+const uint64_t MaxPixels = (uint64_t)1 << 28;
+
+uint32_t ReadBE32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Undoes the per-row filters in place; rows are 1 filter byte then rowBytes
+bool Unfilter(uint8_t* data, uint32_t height, size_t rowBytes, size_t pixelBytes)
+{
+    const uint8_t* prior = nullptr;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t filter = data[0];
+        uint8_t* row = data + 1;
+        for (size_t i = 0; i < rowBytes; i++) {
+            uint8_t a = i >= pixelBytes ? row[i - pixelBytes] : 0;
+            uint8_t b = prior ? prior[i] : 0;
+            uint8_t c = prior && i >= pixelBytes ? prior[i - pixelBytes] : 0;
+            switch (filter) {
+            case 0: break;
+            case 1: row[i] += a; break;
+            case 2: row[i] += b; break;
+            case 3: row[i] += (uint8_t)((a + b) >> 1); break;
+            case 4: row[i] += Paeth(a, b, c); break;
+            default: return false;
+            }
+        }
+        prior = row;
+        data += rowBytes + 1;
+    }
+    return true;
+}
+
+bool LoadPng(const uint8_t* data, size_t size, Image& out)
+{
+    uint32_t width = 0, height = 0;
+    uint8_t depth = 0, colorType = 0;
+    bool haveHeader = false;
+    std::vector<uint8_t> zlib, palette;
+    size_t pos = sizeof(PngSignature);
+    while (pos + 12 <= size) {
+        uint32_t length = ReadBE32(data + pos);
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* body = data + pos + 8;
+        if (length > size - pos - 12) return false;
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length < 13 || body[10] != 0 || body[11] != 0 || body[12] != 0) return false; // deflate, adaptive, not interlaced
+            width = ReadBE32(body);
+            height = ReadBE32(body + 4);
+            depth = body[8];
+            colorType = body[9];
+            haveHeader = true;
+        }
+        else if (std::memcmp(type, "PLTE", 4) == 0) palette.assign(body, body + length);
+        else if (std::memcmp(type, "IDAT", 4) == 0) zlib.insert(zlib.end(), body, body + length);
+        else if (std::memcmp(type, "IEND", 4) == 0) break;
+        pos += 12 + (size_t)length;
+    }
+    if (!haveHeader || width == 0 || height == 0 || (uint64_t)width * height > MaxPixels) return false;
+
+    int channels;
+    switch (colorType) {
+    case 0: channels = 1; break; // gray
+    case 2: channels = 3; break; // RGB
+    case 3: channels = 1; break; // palette
+    case 4: channels = 2; break; // gray + alpha
+    case 6: channels = 4; break; // RGBA
+    default: return false;
+    }
+    bool validDepth = colorType == 3 ? depth == 1 || depth == 2 || depth == 4 || depth == 8
+        : colorType == 0 ? depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16
+        : depth == 8 || depth == 16;
+    if (!validDepth || (colorType == 3 && palette.size() < 3)) return false;
+
+    const size_t bitsPerPixel = (size_t)channels * depth;
+    const size_t rowBytes = (width * bitsPerPixel + 7) / 8;
+    const size_t pixelBytes = (bitsPerPixel + 7) / 8;
+    std::vector<uint8_t> raw((rowBytes + 1) * height);
+    if (!InflateZlib(zlib.data(), zlib.size(), raw.data(), raw.size())) return false;
+    if (!Unfilter(raw.data(), height, rowBytes, pixelBytes)) return false;
+
+    out.width = (int)width;
+    out.height = (int)height;
+    out.rgb.resize((size_t)width * height * 3);
+    const size_t paletteEntries = palette.size() / 3;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = raw.data() + y * (rowBytes + 1) + 1;
+        uint8_t* dst = out.rgb.data() + (size_t)y * width * 3;
+        for (uint32_t x = 0; x < width; x++, dst += 3) {
+            if (depth < 8) {
+                // packed from the high bits down
+                size_t bit = (size_t)x * depth;
+                uint32_t v = (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+                if (colorType == 3) {
+                    if (v >= paletteEntries) return false;
+                    std::memcpy(dst, &palette[v * 3], 3);
+                }
+                else dst[0] = dst[1] = dst[2] = (uint8_t)(v * 255 / ((1u << depth) - 1));
+                continue;
+            }
+            // high byte of each channel
+            const uint8_t* p = row + (size_t)x * pixelBytes;
+            const size_t step = depth / 8;
+            if (colorType == 3) {
+                if (p[0] >= paletteEntries) return false;
+                std::memcpy(dst, &palette[p[0] * 3], 3);
+            }
+            else if (channels <= 2) dst[0] = dst[1] = dst[2] = p[0];
+            else { dst[0] = p[0]; dst[1] = p[step]; dst[2] = p[2 * step]; }
+        }
+    }
+    return true;
+}
+
+// PPM header field: digits after whitespace and # comments
+bool PpmNumber(const uint8_t* data, size_t size, size_t& pos, uint32_t& value)
+{
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n' || data[pos] == '#')) {
+        if (data[pos] == '#') while (pos < size && data[pos] != '\n') pos++;
+        else pos++;
+    }
+    if (pos >= size || data[pos] < '0' || data[pos] > '9') return false;
+    value = 0;
+    while (pos < size && data[pos] >= '0' && data[pos] <= '9') {
+        if (value > 100000000) return false;
+        value = value * 10 + (data[pos++] - '0');
+    }
+    return true;
+}
+
+bool LoadPpm(const uint8_t* data, size_t size, Image& out)
+{
+    size_t pos = 2;
+    uint32_t width, height, maxValue;
+    if (!PpmNumber(data, size, pos, width) || !PpmNumber(data, size, pos, height) || !PpmNumber(data, size, pos, maxValue)) return false;
+    pos++; // the single whitespace byte before the pixels
+    if (width == 0 || height == 0 || (uint64_t)width * height > MaxPixels || maxValue == 0 || maxValue > 65535) return false;
+    const size_t sampleBytes = maxValue > 255 ? 2 : 1;
+    const size_t count = (size_t)width * height * 3;
+    if (pos > size || size - pos < count * sampleBytes) return false;
+
+    out.width = (int)width;
+    out.height = (int)height;
+    out.rgb.resize(count);
+    const uint8_t* p = data + pos;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v = sampleBytes == 2 ? (uint32_t)p[i * 2] << 8 | p[i * 2 + 1] : p[i];
+        out.rgb[i] = (uint8_t)((v * 255 + maxValue / 2) / maxValue);
+    }
+    return true;
+}
+
+} // namespace
+
+bool ReadImage(const uint8_t* data, size_t size, Image& out)
+{
+    out = Image();
+    bool ok = false;
+    if (size >= sizeof(PngSignature) && std::memcmp(data, PngSignature, sizeof(PngSignature)) == 0) ok = LoadPng(data, size, out);
+    else if (size >= 2 && data[0] == 'P' && data[1] == '6') ok = LoadPpm(data, size, out);
+    if (!ok) out = Image();
+    return ok;
+}
+
+bool ReadImage(const std::string& path, Image& out)
+{
+    MappedFile file;
+    if (!file.Open(path)) {
+        out = Image();
+        return false;
+    }
+    return ReadImage((const uint8_t*)file.Data(), file.Size(), out);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 8-bit RGB pixels, rows top to bottom
+struct Image {
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgb; // width * height * 3
+
+    bool IsEmpty() const { return rgb.empty(); }
+};
+
+// Decodes a PNG (non-interlaced, any bit depth and color type; alpha is dropped
+// and 16-bit channels keep their high byte) or a binary PPM (P6), picked by the
+// file's signature. Returns false if the file cannot be read or is not one of
+// these. (Not LoadImage, which windows.h defines as a macro.)
+bool ReadImage(const std::string& path, Image& out);
+
+// Same, over file contents already in memory
+bool ReadImage(const uint8_t* data, size_t size, Image& out);
@@ -0,0 +1,270 @@
+#include "Inflate.h"
+#include <cstring>
+
+namespace {
+
+const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const uint8_t LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const uint16_t DistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+const uint8_t DistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// LSB-first bit buffer that keeps at least 56 bits loaded. Reading past the end
+// feeds zeros and marks the stream as overrun once more than the buffered bytes were used.
+struct BitReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t bits = 0;
+    int count = 0;
+    size_t padding = 0;
+
+    BitReader(const uint8_t* src, size_t size) : p(src), end(src + size) {}
+
+    void Refill() {
+        if (end - p >= 8 && count <= 56) {
+            uint64_t word;
+            std::memcpy(&word, p, 8);
+            bits |= word << count;
+            p += (63 - count) >> 3;
+            count |= 56;
+            return;
+        }
+        while (count <= 56) {
+            uint64_t b = 0;
+            if (p < end) b = *p++;
+            else padding++;
+            bits |= b << count;
+            count += 8;
+        }
+    }
+    uint32_t Peek(int n) const { return (uint32_t)(bits & ((1ull << n) - 1)); }
+    void Drop(int n) { bits >>= n; count -= n; }
+    uint32_t Get(int n) {
+        Refill();
+        uint32_t v = Peek(n);
+        Drop(n);
+        return v;
+    }
+    void AlignToByte() { Drop(count & 7); }
+    bool Overrun() const { return padding * 8 > (size_t)count; }
+};
+
+// Canonical Huffman decoder: codes up to FastBits long resolve with one table
+// lookup, longer ones fall back to walking the per-length counts
+struct Huffman {
+    static const int MaxBits = 15;
+    static const int FastBits = 9;
+
+    uint16_t fast[1 << FastBits]; // (symbol << 4) | length, 0 when the code is longer
+    uint16_t count[MaxBits + 1];
+    uint16_t symbol[288];
+
+    bool Build(const uint8_t* lengths, int n) {
+        std::memset(count, 0, sizeof(count));
+        for (int i = 0; i < n; i++) count[lengths[i]]++;
+        count[0] = 0;
+
+        int left = 1;
+        for (int len = 1; len <= MaxBits; len++) {
+            left = (left << 1) - count[len];
+            if (left < 0) return false; // over-subscribed
+        }
+
+        uint16_t offset[MaxBits + 2];
+        offset[1] = 0;
+        for (int len = 1; len <= MaxBits; len++) offset[len + 1] = offset[len] + count[len];
+        for (int i = 0; i < n; i++)
+            if (lengths[i]) symbol[offset[lengths[i]]++] = (uint16_t)i;
+
+        std::memset(fast, 0, sizeof(fast));
+        uint32_t code = 0;
+        int index = 0;
+        for (int len = 1; len <= FastBits; len++) {
+            for (int k = 0; k < count[len]; k++, code++, index++) {
+                uint32_t reversed = 0;
+                for (int b = 0; b < len; b++) reversed |= ((code >> b) & 1) << (len - 1 - b);
+                uint16_t entry = (uint16_t)((symbol[index] << 4) | len);
+                for (uint32_t slot = reversed; slot < (1u << FastBits); slot += 1u << len) fast[slot] = entry;
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    // -1 for a code that is not in the table
+    int Decode(BitReader& br) const {
+        br.Refill();
+        uint16_t entry = fast[br.Peek(FastBits)];
+        if (entry) {
+            br.Drop(entry & 15);
+            return entry >> 4;
+        }
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= MaxBits; len++) {
+            code |= (int)br.Peek(1);
+            br.Drop(1);
+            int n = count[len];
+            if (code - first < n) return symbol[index + code - first];
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+};
+
+struct FixedTables {
+    Huffman lit, dist;
+    FixedTables() {
+        uint8_t lengths[288];
+        for (int i = 0; i < 144; i++) lengths[i] = 8;
+        for (int i = 144; i < 256; i++) lengths[i] = 9;
+        for (int i = 256; i < 280; i++) lengths[i] = 7;
+        for (int i = 280; i < 288; i++) lengths[i] = 8;
+        lit.Build(lengths, 288);
+        for (int i = 0; i < 30; i++) lengths[i] = 5;
+        dist.Build(lengths, 30);
+    }
+};
+
+bool ReadDynamicTables(BitReader& br, Huffman& lit, Huffman& dist)
+{
+    int litCount = (int)br.Get(5) + 257;
+    int distCount = (int)br.Get(5) + 1;
+    int lengthCount = (int)br.Get(4) + 4;
+    if (litCount > 286 || distCount > 30) return false;
+
+    uint8_t lengths[286 + 30] = {};
+    for (int i = 0; i < lengthCount; i++) lengths[CodeLengthOrder[i]] = (uint8_t)br.Get(3);
+    Huffman lengthCode;
+    if (!lengthCode.Build(lengths, 19)) return false;
+
+    std::memset(lengths, 0, sizeof(lengths));
+    int total = litCount + distCount;
+    for (int i = 0; i < total;) {
+        int sym = lengthCode.Decode(br);
+        if (sym < 0) return false;
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+        uint8_t value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (i == 0) return false;
+            value = lengths[i - 1];
+            repeat = 3 + (int)br.Get(2);
+        }
+        else if (sym == 17) repeat = 3 + (int)br.Get(3);
+        else repeat = 11 + (int)br.Get(7);
+        if (i + repeat > total) return false;
+        while (repeat--) lengths[i++] = value;
+    }
+    if (lengths[256] == 0) return false; // no end-of-block code
+    return lit.Build(lengths, litCount) && dist.Build(lengths + litCount, distCount);
+}
+
+bool InflateBlock(BitReader& br, const Huffman& lit, const Huffman& dist, uint8_t* dst, size_t dstSize, size_t& out)
+{
+    for (;;) {
+        int sym = lit.Decode(br);
+        if (sym < 256) {
+            if (sym < 0 || out >= dstSize) return false;
+            dst[out++] = (uint8_t)sym;
+            continue;
+        }
+        if (sym == 256) return true;
+
+        sym -= 257;
+        if (sym >= 29) return false;
+        size_t length = LengthBase[sym] + br.Get(LengthExtra[sym]);
+        int d = dist.Decode(br);
+        if (d < 0 || d >= 30) return false;
+        size_t distance = DistBase[d] + br.Get(DistExtra[d]);
+        if (distance > out || length > dstSize - out) return false;
+
+        uint8_t* to = dst + out;
+        const uint8_t* from = to - distance;
+        if (distance >= length) std::memcpy(to, from, length);
+        else for (size_t i = 0; i < length; i++) to[i] = from[i]; // overlapping run
+        out += length;
+    }
+}
+
+uint32_t Adler32(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size) {
+        size_t n = size < 5552 ? size : 5552; // largest run before the sums can overflow
+        size -= n;
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+} // namespace
+
+bool InflateZlib(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    if (srcSize < 6) return false;
+    uint8_t cmf = src[0], flg = src[1];
+    if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return false;
+
+    static const FixedTables fixed;
+    BitReader br(src + 2, srcSize - 6);
+    Huffman lit, dist;
+    size_t out = 0;
+    bool last = false;
+    while (!last) {
+        last = br.Get(1) != 0;
+        uint32_t type = br.Get(2);
+        if (type == 0) {
+            // stored: byte-aligned LEN, NLEN, raw bytes; drain the bit buffer back into the stream
+            br.AlignToByte();
+            size_t buffered = (size_t)br.count >> 3;
+            if (br.padding > buffered) return false;
+            br.p -= buffered - br.padding;
+            br.bits = 0;
+            br.count = 0;
+            br.padding = 0;
+            if (br.end - br.p < 4) return false;
+            uint16_t len = (uint16_t)(br.p[0] | (br.p[1] << 8));
+            uint16_t nlen = (uint16_t)(br.p[2] | (br.p[3] << 8));
+            br.p += 4;
+            if ((uint16_t)~nlen != len || (size_t)(br.end - br.p) < len || len > dstSize - out) return false;
+            std::memcpy(dst + out, br.p, len);
+            br.p += len;
+            out += len;
+        }
+        else if (type == 1) {
+            if (!InflateBlock(br, fixed.lit, fixed.dist, dst, dstSize, out)) return false;
+        }
+        else if (type == 2) {
+            if (!ReadDynamicTables(br, lit, dist) || !InflateBlock(br, lit, dist, dst, dstSize, out)) return false;
+        }
+        else return false;
+        if (br.Overrun()) return false;
+    }
+    if (out != dstSize) return false;
+
+    const uint8_t* trailer = src + srcSize - 4;
+    uint32_t expected = ((uint32_t)trailer[0] << 24) | ((uint32_t)trailer[1] << 16) | ((uint32_t)trailer[2] << 8) | trailer[3];
+    return Adler32(dst, dstSize) == expected;
+}
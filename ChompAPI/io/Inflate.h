@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Decodes a zlib stream (RFC 1950 header + RFC 1951 deflate + Adler-32) whose
+// decoded size is known up front, as it is for FBX property arrays. Returns
+// false on malformed input or if the output is not exactly dstSize bytes.
+bool InflateZlib(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
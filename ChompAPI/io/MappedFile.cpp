@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(f, &len)) { CloseHandle(f); return false; }
+    file = f;
+    size = (size_t)len.QuadPart;
+    open = true;
+    if (size == 0) return true;
+
+    HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m) { Close(); return false; }
+    mapping = m;
+    data = (const char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (!data) { Close(); return false; }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle((HANDLE)mapping);
+    if (file) CloseHandle((HANDLE)file);
+    data = nullptr; mapping = nullptr; file = nullptr;
+    size = 0;
+    open = false;
+}
+#else
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    size = (size_t)st.st_size;
+    open = true;
+    if (size > 0) {
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { ::close(fd); size = 0; open = false; return false; }
+        madvise(p, size, MADV_SEQUENTIAL);
+        data = (const char*)p;
+    }
+    ::close(fd); // the mapping keeps the file alive
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data) munmap((void*)data, size);
+    data = nullptr;
+    size = 0;
+    open = false;
+}
+#endif
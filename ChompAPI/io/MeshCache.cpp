@@ -0,0 +1,276 @@
+#include "MeshCache.h"
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace {
+
+const char Magic[8] = { 'C','H','O','M','P','M','S','H' };
+const uint32_t EndianTag = 0x01020304;
+const uint64_t BlockAlign = 64;
+
+enum BlockType : uint32_t {
+    BlockPositionX = 1,
+    BlockPositionY = 2,
+    BlockPositionZ = 3,
+    BlockIndices = 4,
+    BlockLodIndices = 5,
+    BlockLods = 6,
+    BlockNormalX = 7,
+    BlockNormalY = 8,
+    BlockNormalZ = 9,
+    BlockFaceNormals = 10,
+    BlockLodFaceNormals = 11,
+    BlockTexU = 12,
+    BlockTexV = 13
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint32_t blockCount;
+    uint32_t reserved;
+};
+
+struct Block {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+uint64_t AlignUp(uint64_t v) { return (v + BlockAlign - 1) & ~(BlockAlign - 1); }
+
+// every index below limit; run once at open so a damaged file never reaches the vertex reads
+bool IndicesBelow(const uint32_t* indices, size_t count, uint64_t limit)
+{
+    uint32_t maxIndex = 0;
+    for (size_t i = 0; i < count; i++) maxIndex = std::max(maxIndex, indices[i]);
+    return count == 0 || maxIndex < limit;
+}
+
+// replaces `to` atomically, so a crash leaves either the old file or the new one
+bool MoveOver(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool StatSource(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+    std::error_code ec;
+    size = (uint64_t)std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+} // namespace
+
+std::string MeshCache::PathFor(const std::string& sourcePath)
+{
+    return sourcePath + ".chompmesh";
+}
+
+uint64_t MeshCache::HashBytes(const char* data, size_t size)
+{
+    const uint64_t k1 = 0xff51afd7ed558ccdull, k2 = 0xc4ceb9fe1a85ec53ull;
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        w *= k1;
+        w ^= w >> 32;
+        h = (h ^ w) * k2;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++) h = (h ^ (unsigned char)data[i]) * k1;
+    h ^= h >> 33; h *= k2; h ^= h >> 33;
+    return h;
+}
+
+bool MeshCache::Stamp(const std::string& sourcePath, const char* data, size_t size, SourceStamp& out)
+{
+    if (!StatSource(sourcePath, out.size, out.mtime)) return false;
+    out.hash = HashBytes(data, size);
+    return true;
+}
+
+bool MeshCache::Open(const std::string& cachePath, const std::string& sourcePath)
+{
+    Close();
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!StatSource(sourcePath, sourceSize, sourceTime)) return false;
+    if (!file.Open(cachePath)) return false;
+
+    const char* base = file.Data();
+    const size_t size = file.Size();
+    Header h;
+    if (size < sizeof(Header)) { Close(); return false; }
+    std::memcpy(&h, base, sizeof(Header));
+    if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.version != Version || h.endian != EndianTag ||
+        h.sourceSize != sourceSize) {
+        Close();
+        return false;
+    }
+
+    if (h.sourceTime != sourceTime) {
+        // touched but maybe unchanged: fall back to comparing contents
+        MappedFile source;
+        if (!source.Open(sourcePath) || HashBytes(source.Data(), source.Size()) != h.sourceHash) {
+            Close();
+            return false;
+        }
+    }
+
+    if (sizeof(Header) + (uint64_t)h.blockCount * sizeof(Block) > size) { Close(); return false; }
+    MeshView v;
+    v.vertexCount = (size_t)h.vertexCount;
+    v.indexCount = (size_t)h.indexCount;
+    uint64_t lodIndexCount = 0, lodFaceNormalCount = 0;
+    for (uint32_t i = 0; i < h.blockCount; i++) {
+        Block b;
+        std::memcpy(&b, base + sizeof(Header) + i * sizeof(Block), sizeof(Block));
+        if (b.offset % BlockAlign != 0 || b.offset > size || b.bytes > size - b.offset) { Close(); return false; }
+        const void* p = base + b.offset;
+        uint64_t floats = h.vertexCount * sizeof(float);
+        switch (b.type) {
+        case BlockPositionX: if (b.bytes != floats) { Close(); return false; } v.x = (const float*)p; break;
+        case BlockPositionY: if (b.bytes != floats) { Close(); return false; } v.y = (const float*)p; break;
+        case BlockPositionZ: if (b.bytes != floats) { Close(); return false; } v.z = (const float*)p; break;
+        case BlockIndices: if (b.bytes != h.indexCount * sizeof(uint32_t)) { Close(); return false; } v.indices = (const uint32_t*)p; break;
+        case BlockLodIndices: lodIndexCount = b.bytes / sizeof(uint32_t); v.lodIndices = (const uint32_t*)p; break;
+        case BlockLods: v.lodCount = (size_t)(b.bytes / sizeof(MeshLod)); v.lods = (const MeshLod*)p; break;
+        case BlockNormalX: if (b.bytes != floats) { Close(); return false; } v.nx = (const float*)p; break;
+        case BlockNormalY: if (b.bytes != floats) { Close(); return false; } v.ny = (const float*)p; break;
+        case BlockNormalZ: if (b.bytes != floats) { Close(); return false; } v.nz = (const float*)p; break;
+        case BlockFaceNormals: if (b.bytes != h.indexCount / 3 * sizeof(Vec3)) { Close(); return false; } v.faceNormals = (const Vec3*)p; break;
+        case BlockLodFaceNormals: lodFaceNormalCount = b.bytes / sizeof(Vec3); v.lodFaceNormals = (const Vec3*)p; break;
+        case BlockTexU: if (b.bytes != floats) { Close(); return false; } v.texU = (const float*)p; break;
+        case BlockTexV: if (b.bytes != floats) { Close(); return false; } v.texV = (const float*)p; break;
+        default: break; // unknown blocks from newer writers are skipped
+        }
+    }
+    if ((v.vertexCount && (!v.x || !v.y || !v.z)) || (v.indexCount && !v.indices)) { Close(); return false; }
+    if (!IndicesBelow(v.indices, v.indexCount, v.vertexCount)) { Close(); return false; }
+    // normals come as a set or not at all
+    if (v.nx || v.ny || v.nz || v.faceNormals || v.lodFaceNormals) {
+        if (!v.nx || !v.ny || !v.nz || !v.faceNormals || (lodIndexCount && !v.lodFaceNormals) ||
+            lodFaceNormalCount != lodIndexCount / 3) {
+            Close();
+            return false;
+        }
+    }
+    if (!v.texU != !v.texV) { Close(); return false; }
+    for (size_t i = 0; i < v.lodCount; i++) {
+        const MeshLod& l = v.lods[i];
+        if ((uint64_t)l.indexOffset + l.indexCount > lodIndexCount || l.vertexCount > v.vertexCount ||
+            !IndicesBelow(v.lodIndices + l.indexOffset, l.indexCount, l.vertexCount)) {
+            Close();
+            return false;
+        }
+    }
+
+    view = v;
+    return true;
+}
+
+void MeshCache::Close()
+{
+    file.Close();
+    view = MeshView();
+}
+
+bool MeshCache::Write(const std::string& cachePath, const MeshView& mesh, const SourceStamp& stamp)
+{
+    struct Payload { uint32_t type; const void* data; uint64_t bytes; };
+    const uint64_t floats = mesh.vertexCount * sizeof(float);
+    uint64_t lodIndexCount = 0;
+    for (size_t i = 0; i < mesh.lodCount; i++)
+        lodIndexCount = std::max<uint64_t>(lodIndexCount, (uint64_t)mesh.lods[i].indexOffset + mesh.lods[i].indexCount);
+    std::vector<Payload> payloads = {
+        { BlockPositionX, mesh.x, floats },
+        { BlockPositionY, mesh.y, floats },
+        { BlockPositionZ, mesh.z, floats },
+        { BlockIndices, mesh.indices, mesh.indexCount * sizeof(uint32_t) },
+        { BlockLodIndices, mesh.lodIndices, lodIndexCount * sizeof(uint32_t) },
+        { BlockLods, mesh.lods, mesh.lodCount * sizeof(MeshLod) },
+    };
+    if (mesh.nx) {
+        payloads.push_back({ BlockNormalX, mesh.nx, floats });
+        payloads.push_back({ BlockNormalY, mesh.ny, floats });
+        payloads.push_back({ BlockNormalZ, mesh.nz, floats });
+        payloads.push_back({ BlockFaceNormals, mesh.faceNormals, mesh.indexCount / 3 * sizeof(Vec3) });
+        payloads.push_back({ BlockLodFaceNormals, mesh.lodFaceNormals, lodIndexCount / 3 * sizeof(Vec3) });
+    }
+    if (mesh.texU) {
+        payloads.push_back({ BlockTexU, mesh.texU, floats });
+        payloads.push_back({ BlockTexV, mesh.texV, floats });
+    }
+    const uint32_t blockCount = (uint32_t)payloads.size();
+
+    Header h = {};
+    std::memcpy(h.magic, Magic, sizeof(Magic));
+    h.version = Version;
+    h.endian = EndianTag;
+    h.sourceSize = stamp.size;
+    h.sourceTime = stamp.mtime;
+    h.sourceHash = stamp.hash;
+    h.vertexCount = mesh.vertexCount;
+    h.indexCount = mesh.indexCount;
+    h.blockCount = blockCount;
+
+    std::vector<Block> blocks(blockCount);
+    uint64_t offset = AlignUp(sizeof(Header) + blockCount * sizeof(Block));
+    for (uint32_t i = 0; i < blockCount; i++) {
+        blocks[i] = { payloads[i].type, 0, offset, payloads[i].bytes };
+        offset = AlignUp(offset + payloads[i].bytes);
+    }
+
+    std::string tmpPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write((const char*)&h, sizeof(h));
+        out.write((const char*)blocks.data(), blocks.size() * sizeof(Block));
+
+        const char zeros[BlockAlign] = {};
+        uint64_t written = sizeof(h) + blocks.size() * sizeof(Block);
+        for (uint32_t i = 0; i < blockCount; i++) {
+            out.write(zeros, (std::streamsize)(blocks[i].offset - written));
+            if (payloads[i].bytes) out.write((const char*)payloads[i].data, (std::streamsize)payloads[i].bytes);
+            written = blocks[i].offset + payloads[i].bytes;
+        }
+        if (!out) return false;
+    }
+
+    if (!MoveOver(tmpPath, cachePath)) {
+        std::error_code ec;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "MappedFile.h"
+#include "../objects/Mesh.h"
+
+// Identity of the source file a cache was built from
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+};
+
+// .chompmesh: little-endian header, block table, then 64-byte aligned
+// position (x, y, z), index, LOD and (when the mesh has them) normal and
+// texture coordinate blocks.
+// Open maps the file and points a MeshView straight at the blocks, with no
+// parsing or copying.
+class MeshCache {
+public:
+    static const uint32_t Version = 5; // 4: vertex and face normals, 5: texture coordinates
+
+    // "<source>.chompmesh"
+    static std::string PathFor(const std::string& sourcePath);
+    static uint64_t HashBytes(const char* data, size_t size);
+    // size + mtime from the filesystem, hash of the given contents
+    static bool Stamp(const std::string& sourcePath, const char* data, size_t size, SourceStamp& out);
+
+    // Maps cachePath and checks it against sourcePath: size and mtime must match,
+    // or, if only the mtime moved, the content hash must. Every index is checked
+    // against its vertex count once, so a damaged file is rejected here.
+    bool Open(const std::string& cachePath, const std::string& sourcePath);
+    void Close();
+    bool IsOpen() const { return file.IsOpen(); }
+    const MeshView& View() const { return view; }
+
+    // Writes through a temporary file and renames it over cachePath in one step
+    static bool Write(const std::string& cachePath, const MeshView& mesh, const SourceStamp& stamp);
+
+private:
+    MappedFile file;
+    MeshView view;
+};
@@ -0,0 +1,287 @@
+#include "OBJParser.h"
+#include "MappedFile.h"
+#include "../render/ThreadPool.h"
+#include <algorithm>
+#include <memory>
+
+// bytes of text handed to one parse job
+static const size_t ChunkBytes = 1 << 20;
+
+namespace {
+
+struct Chunk {
+    const char* begin;
+    const char* end;
+
+    VertexBuffer positions;
+    std::vector<float> texU, texV;
+    VertexBuffer normals;
+    std::vector<OBJCorner> corners;
+    // corner slots holding a negative index, resolved against this chunk's own counts so far
+    std::vector<uint32_t> relativeV, relativeVT, relativeVN;
+};
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char* SkipSpace(const char* p, const char* end)
+{
+    while (p < end && IsSpace(*p)) p++;
+    return p;
+}
+
+const double Pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// [sign] digits [. digits] [e [sign] digits], up to 19 significant digits
+const char* ScanFloat(const char* p, const char* end, float& out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; p < end && IsDigit(*p); p++) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa) digits++;
+        }
+        else exponent++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && IsDigit(*p); p++) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negExp = false;
+        if (q < end && (*q == '-' || *q == '+')) negExp = *q++ == '-';
+        int e = 0;
+        if (q < end && IsDigit(*q)) {
+            for (; q < end && IsDigit(*q); q++) e = std::min(e * 10 + (*q - '0'), 10000);
+            exponent += negExp ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = (double)mantissa;
+    while (exponent > 22) { value *= 1e22; exponent -= 22; }
+    while (exponent < -22) { value /= 1e22; exponent += 22; }
+    value = exponent >= 0 ? value * Pow10[exponent] : value / Pow10[-exponent];
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+const char* ScanInt(const char* p, const char* end, int64_t& out, bool& ok)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    int64_t v = 0;
+    ok = p < end && IsDigit(*p);
+    for (; p < end && IsDigit(*p); p++) v = std::min<int64_t>(v * 10 + (*p - '0'), INT64_C(1) << 40);
+    out = negative ? -v : v;
+    return p;
+}
+
+// 1-based absolute or negative relative index -> 0-based, relative ones still chunk-local
+int32_t ResolveIndex(int64_t raw, size_t localCount, bool& relative)
+{
+    relative = raw < 0;
+    if (raw > 0) return (int32_t)std::min<int64_t>(raw - 1, INT32_MAX);
+    if (raw < 0) return (int32_t)std::max<int64_t>((int64_t)localCount + raw, INT32_MIN);
+    return -2; // index 0 is never valid
+}
+
+// A face corner as parsed, before relative indices are resolved
+struct FaceCorner {
+    OBJCorner corner;
+    bool relative[3]; // v, vt, vn
+};
+
+void EmitCorner(Chunk& c, const FaceCorner& k)
+{
+    uint32_t slot = (uint32_t)c.corners.size();
+    if (k.relative[0]) c.relativeV.push_back(slot);
+    if (k.relative[1]) c.relativeVT.push_back(slot);
+    if (k.relative[2]) c.relativeVN.push_back(slot);
+    c.corners.push_back(k.corner);
+}
+
+void ParseChunk(Chunk& c)
+{
+    const char* p = c.begin;
+    const char* end = c.end;
+
+    while (p < end) {
+        const char* lineEnd = std::find(p, end, '\n');
+        p = SkipSpace(p, lineEnd);
+
+        if (p + 1 < lineEnd && p[0] == 'v' && IsSpace(p[1])) {
+            float xyz[3] = { 0, 0, 0 };
+            const char* q = p + 1;
+            for (int i = 0; i < 3; i++) q = ScanFloat(SkipSpace(q, lineEnd), lineEnd, xyz[i]);
+            c.positions.Add({ xyz[0], xyz[1], xyz[2] });
+        }
+        else if (p + 2 < lineEnd && p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) {
+            float uv[2] = { 0, 0 };
+            const char* q = p + 2;
+            for (int i = 0; i < 2; i++) q = ScanFloat(SkipSpace(q, lineEnd), lineEnd, uv[i]);
+            c.texU.push_back(uv[0]);
+            c.texV.push_back(uv[1]);
+        }
+        else if (p + 2 < lineEnd && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+            float n[3] = { 0, 0, 0 };
+            const char* q = p + 2;
+            for (int i = 0; i < 3; i++) q = ScanFloat(SkipSpace(q, lineEnd), lineEnd, n[i]);
+            c.normals.Add({ n[0], n[1], n[2] });
+        }
+        else if (p + 1 < lineEnd && p[0] == 'f' && IsSpace(p[1])) {
+            // fan-triangulated as the corners arrive, so faces of any size keep every corner
+            FaceCorner first{}, prev{}, k{};
+            int count = 0;
+            const char* q = SkipSpace(p + 1, lineEnd);
+            while (q < lineEnd) {
+                int64_t raw;
+                bool ok;
+                q = ScanInt(q, lineEnd, raw, ok);
+                if (!ok) break;
+
+                OBJCorner& corner = k.corner;
+                bool* rel = k.relative;
+                corner.v = ResolveIndex(raw, c.positions.Size(), rel[0]);
+                corner.vt = -1; corner.vn = -1;
+                rel[1] = rel[2] = false;
+
+                if (q < lineEnd && *q == '/') {
+                    q++;
+                    if (q < lineEnd && *q != '/') {
+                        q = ScanInt(q, lineEnd, raw, ok);
+                        if (ok) corner.vt = ResolveIndex(raw, c.texU.size(), rel[1]);
+                    }
+                    if (q < lineEnd && *q == '/') {
+                        q = ScanInt(q + 1, lineEnd, raw, ok);
+                        if (ok) corner.vn = ResolveIndex(raw, c.normals.Size(), rel[2]);
+                    }
+                }
+                if (count >= 2) {
+                    EmitCorner(c, first);
+                    EmitCorner(c, prev);
+                    EmitCorner(c, k);
+                }
+                if (count == 0) first = k;
+                prev = k;
+                count++;
+                q = SkipSpace(q, lineEnd);
+            }
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+template <typename T>
+void Append(std::vector<T>& dst, size_t offset, const std::vector<T>& src)
+{
+    std::copy(src.begin(), src.end(), dst.begin() + offset);
+}
+
+} // namespace
+
+void ParseOBJ(const char* text, size_t size, OBJData& out, ThreadPool& pool)
+{
+    out = OBJData();
+    if (size == 0) return;
+
+    // newline-aligned chunks
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / ChunkBytes + 1, (size_t)pool.GetThreadCount() * 8));
+    std::vector<Chunk> chunks(chunkCount);
+    const char* end = text + size;
+    const char* cursor = text;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* split = i + 1 == chunkCount ? end : std::max(cursor, text + size * (i + 1) / chunkCount);
+        split = std::find(split, end, '\n');
+        if (split < end) split++;
+        chunks[i].begin = cursor;
+        chunks[i].end = split;
+        cursor = split;
+    }
+
+    pool.ParallelFor((int)chunkCount, [&](int i) { ParseChunk(chunks[i]); });
+
+    // chunk bases
+    std::vector<size_t> baseV(chunkCount + 1, 0), baseVT(chunkCount + 1, 0), baseVN(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; i++) {
+        baseV[i + 1] = baseV[i] + chunks[i].positions.Size();
+        baseVT[i + 1] = baseVT[i] + chunks[i].texU.size();
+        baseVN[i + 1] = baseVN[i] + chunks[i].normals.Size();
+    }
+    const int64_t totalV = (int64_t)baseV[chunkCount];
+    const int64_t totalVT = (int64_t)baseVT[chunkCount];
+    const int64_t totalVN = (int64_t)baseVN[chunkCount];
+
+    // resolve relative indices, then drop triangles whose positions are missing
+    // (a missing texcoord or normal just reads as absent)
+    pool.ParallelFor((int)chunkCount, [&](int i) {
+        Chunk& c = chunks[i];
+        for (uint32_t s : c.relativeV) c.corners[s].v += (int32_t)baseV[i];
+        for (uint32_t s : c.relativeVT) c.corners[s].vt += (int32_t)baseVT[i];
+        for (uint32_t s : c.relativeVN) c.corners[s].vn += (int32_t)baseVN[i];
+
+        auto valid = [&](OBJCorner& k) {
+            if (k.vt < 0 || k.vt >= totalVT) k.vt = -1;
+            if (k.vn < 0 || k.vn >= totalVN) k.vn = -1;
+            return k.v >= 0 && k.v < totalV;
+        };
+        size_t kept = 0;
+        for (size_t t = 0; t + 2 < c.corners.size(); t += 3) {
+            if (!valid(c.corners[t]) || !valid(c.corners[t + 1]) || !valid(c.corners[t + 2])) continue;
+            for (int k = 0; k < 3; k++) c.corners[kept++] = c.corners[t + k];
+        }
+        c.corners.resize(kept);
+        });
+
+    std::vector<size_t> baseC(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; i++) baseC[i + 1] = baseC[i] + chunks[i].corners.size();
+
+    out.positions.x.resize(totalV); out.positions.y.resize(totalV); out.positions.z.resize(totalV);
+    out.texU.resize(totalVT); out.texV.resize(totalVT);
+    out.normals.x.resize(totalVN); out.normals.y.resize(totalVN); out.normals.z.resize(totalVN);
+    out.corners.resize(baseC[chunkCount]);
+
+    pool.ParallelFor((int)chunkCount, [&](int i) {
+        const Chunk& c = chunks[i];
+        Append(out.positions.x, baseV[i], c.positions.x);
+        Append(out.positions.y, baseV[i], c.positions.y);
+        Append(out.positions.z, baseV[i], c.positions.z);
+        Append(out.texU, baseVT[i], c.texU);
+        Append(out.texV, baseVT[i], c.texV);
+        Append(out.normals.x, baseVN[i], c.normals.x);
+        Append(out.normals.y, baseVN[i], c.normals.y);
+        Append(out.normals.z, baseVN[i], c.normals.z);
+        Append(out.corners, baseC[i], c.corners);
+        });
+}
+
+bool ParseOBJ(const std::string& path, OBJData& out, ThreadPool* pool)
+{
+    MappedFile file;
+    if (!file.Open(path)) return false;
+
+    std::unique_ptr<ThreadPool> ownPool;
+    if (!pool) {
+        ownPool = std::make_unique<ThreadPool>();
+        pool = ownPool.get();
+    }
+    ParseOBJ(file.Data(), file.Size(), out, *pool);
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../render/VertexStage.h"
+
+class ThreadPool;
+
+// One face corner, 0-based; vt/vn are -1 when the face did not give them
+struct OBJCorner {
+    int32_t v, vt, vn;
+};
+
+struct OBJData {
+    VertexBuffer positions;
+    std::vector<float> texU, texV;
+    VertexBuffer normals;
+    std::vector<OBJCorner> corners; // three per triangle, polygons fan-triangulated
+};
+
+// Memory-maps the file and parses newline-aligned chunks of it in parallel.
+// Accepts v, v/vt, v//vn and v/vt/vn corners and negative (relative) indices;
+// faces that reference missing positions are dropped. A null pool parses on a
+// temporary one. Returns false only if the file cannot be opened.
+bool ParseOBJ(const std::string& path, OBJData& out, ThreadPool* pool = nullptr);
+
+// Same, over text already in memory
+void ParseOBJ(const char* text, size_t size, OBJData& out, ThreadPool& pool);
@@ -1,44 +1,9 @@
-#include <iostream>
-#include <vector>
-#include <cmath>
-#include <algorithm>
-#include <conio.h> // for _kbhit() and _getch()
-
-struct Vec3 {
-    float x, y, z;
-};
-
-struct Color {
-    int r, g, b;
-};
-
-struct Triangle {
-    Vec3 v0, v1, v2;
-};
-
-struct Transform {
-    Vec3 pos = { 0,0,0 };
-    Vec3 rotation = { 0,0,0 }; // only updated by input
-    float scale = 1.0f;
-};
-
-class Cube {
-public:
-    Cube(float size);
-    void Draw(Color color, const Transform& t, int* framebuffer, float* zbuffer, int width, int height);
-
-private:
-    std::vector<Triangle> triangles;
-
-    Vec3 RotateVertex(const Vec3& v, const Vec3& rotation);
-    Vec3 ProjectVertex(const Vec3& v, int width, int height, float scale);
-    void DrawTriangle(int* framebuffer, float* zbuffer, int width, int height,
-        const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color);
-};
+#include "Cube.h"
 
 // Constructor
 Cube::Cube(float s) {
     float hs = s / 2.0f; // half-size
+    std::vector<Triangle> triangles;
 
     // Front face
     triangles.push_back({ {-hs,-hs, hs}, {hs,-hs, hs}, {hs, hs, hs} });
@@ -63,136 +28,35 @@ Cube::Cube(float s) {
     // Bottom face
     triangles.push_back({ {-hs,-hs,-hs}, {hs,-hs, hs}, {-hs,-hs, hs} });
     triangles.push_back({ {-hs,-hs,-hs}, {hs,-hs,-hs}, {hs,-hs, hs} });
-}
-
-// Rotate vertex
-Vec3 Cube::RotateVertex(const Vec3& v, const Vec3& rotation) {
-    Vec3 r = v;
-
-    float cx = cos(rotation.x), sx = sin(rotation.x);
-    float cy = cos(rotation.y), sy = sin(rotation.y);
-    float cz = cos(rotation.z), sz = sin(rotation.z);
-
-    // X
-    float y = r.y * cx - r.z * sx;
-    float z = r.y * sx + r.z * cx;
-    r.y = y; r.z = z;
-
-    // Y
-    float x = r.x * cy + r.z * sy;
-    z = -r.x * sy + r.z * cy;
-    r.x = x; r.z = z;
 
-    // Z
-    x = r.x * cz - r.y * sz;
-    y = r.x * sz + r.y * cz;
-    r.x = x; r.y = y;
-
-    return r;
-}
-
-// Orthographic projection
-Vec3 Cube::ProjectVertex(const Vec3& v, int width, int height, float scale) {
-    return { v.x * scale + width / 2.0f, v.y * scale + height / 2.0f, v.z };
-}
-
-// Draw triangle with Z-buffer
-void Cube::DrawTriangle(int* framebuffer, float* zbuffer, int width, int height,
-    const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color)
-{
-    auto Edge = [](const Vec3& a, const Vec3& b, const Vec3& c) {
-        return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
-        };
-
-    Vec3 U = { v1.x - v0.x, v1.y - v0.y, v1.z - v0.z };
-    Vec3 V = { v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
-    Vec3 normal = { U.y * V.z - U.z * V.y, U.z * V.x - U.x * V.z, U.x * V.y - U.y * V.x };
-    if (normal.z >= 0) return;
-
-    int minX = std::max(0, (int)std::floor(std::min({ v0.x,v1.x,v2.x })));
-    int maxX = std::min(width - 1, (int)std::ceil(std::max({ v0.x,v1.x,v2.x })));
-    int minY = std::max(0, (int)std::floor(std::min({ v0.y,v1.y,v2.y })));
-    int maxY = std::min(height - 1, (int)std::ceil(std::max({ v0.y,v1.y,v2.y })));
-
-    for (int y = minY; y <= maxY; y++) {
-        for (int x = minX; x <= maxX; x++) {
-            Vec3 p = { (float)x + 0.5f, (float)y + 0.5f, 0 };
-            float w0 = Edge(v1, v2, p);
-            float w1 = Edge(v2, v0, p);
-            float w2 = Edge(v0, v1, p);
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                float area = Edge(v0, v1, v2);
-                float alpha = w0 / area, beta = w1 / area, gamma = w2 / area;
-                float z = alpha * v0.z + beta * v1.z + gamma * v2.z;
-                int idx = y * width + x;
-                if (z < zbuffer[idx]) {
-                    framebuffer[idx] = (color.r << 16) | (color.g << 8) | color.b;
-                    zbuffer[idx] = z;
-                }
-            }
-        }
-    }
+    mesh = Mesh::FromTriangles(triangles);
+    bounds = mesh.View().Bounds();
 }
 
 // Draw cube
-void Cube::Draw(Color color, const Transform& t, int* framebuffer, float* zbuffer, int width, int height) {
-    // --- Draw filled cube ---
-    for (auto& tri : triangles) {
-        Vec3 v0 = RotateVertex(tri.v0, t.rotation);
-        Vec3 v1 = RotateVertex(tri.v1, t.rotation);
-        Vec3 v2 = RotateVertex(tri.v2, t.rotation);
-
-        v0 = { v0.x * t.scale + t.pos.x, v0.y * t.scale + t.pos.y, v0.z * t.scale + t.pos.z };
-        v1 = { v1.x * t.scale + t.pos.x, v1.y * t.scale + t.pos.y, v1.z * t.scale + t.pos.z };
-        v2 = { v2.x * t.scale + t.pos.x, v2.y * t.scale + t.pos.y, v2.z * t.scale + t.pos.z };
+void Cube::Draw(Color color, const Transform& t, RenderPipeline& pipeline, bool wireframe) {
+    // the outline is drawn 2% larger, so test a sphere that covers it too
+    BoundingSphere outer = { bounds.center, bounds.radius * (wireframe ? 1.02f : 1.0f) };
+    if (!pipeline.IsVisible(Mat4::FromTransform(t), outer)) return;
 
-        Vec3 p0 = ProjectVertex(v0, width, height, 100.0f);
-        Vec3 p1 = ProjectVertex(v1, width, height, 100.0f);
-        Vec3 p2 = ProjectVertex(v2, width, height, 100.0f);
-
-        DrawTriangle(framebuffer, zbuffer, width, height, p0, p1, p2, color);
-    }
+    // --- Draw filled cube ---
+    const TransformedVertices& fill = pipeline.TransformVertices(t, mesh.vertices);
+    pipeline.SubmitIndexed(fill, mesh.indices.data(), mesh.indices.size(), color);
+    if (!wireframe) return;
 
     // --- Draw outline (wireframe) ---
     Color outlineColor = { 0,0,0 }; // black outline
-    for (auto& tri : triangles) {
-        Vec3 v0 = RotateVertex(tri.v0, t.rotation);
-        Vec3 v1 = RotateVertex(tri.v1, t.rotation);
-        Vec3 v2 = RotateVertex(tri.v2, t.rotation);
-
-        // Slightly scale up for outline
-        float outlineScale = t.scale * 1.02f;
-        v0 = { v0.x * outlineScale + t.pos.x, v0.y * outlineScale + t.pos.y, v0.z * outlineScale + t.pos.z };
-        v1 = { v1.x * outlineScale + t.pos.x, v1.y * outlineScale + t.pos.y, v1.z * outlineScale + t.pos.z };
-        v2 = { v2.x * outlineScale + t.pos.x, v2.y * outlineScale + t.pos.y, v2.z * outlineScale + t.pos.z };
-
-        Vec3 p0 = ProjectVertex(v0, width, height, 100.0f);
-        Vec3 p1 = ProjectVertex(v1, width, height, 100.0f);
-        Vec3 p2 = ProjectVertex(v2, width, height, 100.0f);
-
-        // Draw edges
-        auto DrawLine = [&](Vec3 a, Vec3 b) {
-            int x0 = (int)a.x, y0 = (int)a.y;
-            int x1 = (int)b.x, y1 = (int)b.y;
-            int dx = abs(x1 - x0), dy = abs(y1 - y0);
-            int sx = x0 < x1 ? 1 : -1;
-            int sy = y0 < y1 ? 1 : -1;
-            int err = dx - dy;
-
-            while (true) {
-                if (x0 >= 0 && x0 < width && y0 >= 0 && y0 < height)
-                    framebuffer[y0 * width + x0] = (outlineColor.r << 16) | (outlineColor.g << 8) | outlineColor.b;
-                if (x0 == x1 && y0 == y1) break;
-                int e2 = 2 * err;
-                if (e2 > -dy) { err -= dy; x0 += sx; }
-                if (e2 < dx) { err += dx; y0 += sy; }
-            }
-            };
-
-        DrawLine(p0, p1);
-        DrawLine(p1, p2);
-        DrawLine(p2, p0);
+    Transform outlineT = t;
+    outlineT.scale *= 1.02f; // slightly scale up for outline
+    const TransformedVertices& outline = pipeline.TransformVertices(outlineT, mesh.vertices);
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        // lines are not clipped; skip edges that reach behind the eye
+        if (!(outline.w[mesh.indices[i]] > 0 && outline.w[mesh.indices[i + 1]] > 0 && outline.w[mesh.indices[i + 2]] > 0)) continue;
+        Vec3 p0 = outline.Screen(mesh.indices[i]);
+        Vec3 p1 = outline.Screen(mesh.indices[i + 1]);
+        Vec3 p2 = outline.Screen(mesh.indices[i + 2]);
+        pipeline.SubmitLine(p0, p1, outlineColor);
+        pipeline.SubmitLine(p1, p2, outlineColor);
+        pipeline.SubmitLine(p2, p0, outlineColor);
     }
 }
-
-
@@ -0,0 +1,68 @@
+#include "DrawList.h"
+#include "../render/Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Sort keys. Draws that leave depth alone set the top bit and keep their recorded
+// order, the index in the low bits. Opaque draws sort on their nearest view depth
+// as an ordered integer: its top 11 bits (sign, exponent and two mantissa bits, so
+// buckets a quarter of an octave deep), then their kernel, then 20 more bits of depth.
+static const int IndexBits = 30;
+static const uint64_t IndexMask = (1ull << IndexBits) - 1;
+static const uint64_t AfterOpaque = 1ull << 63;
+
+enum Kernel : uint64_t {
+    FlatKernel,
+    SmoothKernel,
+    TexturedKernel
+};
+
+// Float bits reordered so that unsigned integer order is numeric order
+static uint32_t OrderedBits(float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000u) ? ~u : u | 0x80000000u;
+}
+
+void DrawList::Add(const MeshView& mesh, const BoundingSphere& bounds, const Mat4& model, Color color,
+    RasterState state, const RasterTexture* texture, uint8_t* lod)
+{
+    commands.push_back({ mesh, bounds, model, color, state, texture, lod });
+}
+
+void DrawList::Clear()
+{
+    commands.clear();
+}
+
+void DrawList::Submit(RenderPipeline& pipeline)
+{
+    {
+        CHOMP_PROFILE_SCOPE(ProfileStage::Cull);
+        order.clear();
+        for (size_t i = 0; i < commands.size(); i++) {
+            const Command& c = commands[i];
+            if (!c.state.depthTest || !c.state.depthWrite) {
+                order.push_back(AfterOpaque | i);
+                continue;
+            }
+            // uniform scale: the length of any column of the model's 3x3
+            const Mat4& m = c.model;
+            float scale = std::sqrt(m.m[0][0] * m.m[0][0] + m.m[1][0] * m.m[1][0] + m.m[2][0] * m.m[2][0]);
+            uint32_t depth = OrderedBits(pipeline.ViewDepth(m.TransformPoint(c.bounds.center)) - c.bounds.radius * scale);
+            uint64_t kernel = c.texture && c.mesh.texU ? TexturedKernel : c.mesh.nx ? SmoothKernel : FlatKernel;
+            order.push_back((uint64_t)(depth >> 21) << 52 | kernel << 50 | (uint64_t)((depth >> 1) & 0xFFFFF) << IndexBits | i);
+        }
+        std::sort(order.begin(), order.end());
+    }
+
+    for (uint64_t key : order) {
+        const Command& c = commands[key & IndexMask];
+        size_t level = SelectLod(c.mesh, ModelPixelsPerUnit(pipeline, c.model, c.bounds), c.lod ? *c.lod : 0);
+        if (c.lod) *c.lod = (uint8_t)level;
+        DrawShaded(pipeline, c.mesh.Level(level), c.model, c.color, shading, c.texture, c.state);
+    }
+    Clear();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Types.h"
+#include "Mesh.h"
+#include "Shading.h"
+#include "../render/RenderPipeline.h"
+
+// Mesh draws recorded for a pass and submitted together, in the order that suits
+// the rasterizer rather than the caller's. Opaque draws (depth tested and written)
+// go first, nearest first, so hierarchical Z drops whole objects behind them;
+// among draws at about the same depth, those sharing a triangle kernel (flat,
+// Gouraud, textured) run together. Draws that leave depth alone follow in the
+// order they were recorded, since what they cover depends on it. Recording copies
+// a few words, so the list is meant to be refilled every frame.
+class DrawList {
+public:
+    // bounds is the mesh's model-space sphere; the mesh, its LODs and texture must
+    // stay alive until Submit. lod, when set, is the level drawn last time, kept
+    // for SelectLod's hysteresis and updated by Submit.
+    void Add(const MeshView& mesh, const BoundingSphere& bounds, const Mat4& model, Color color,
+        RasterState state = {}, const RasterTexture* texture = nullptr, uint8_t* lod = nullptr);
+    void Add(const MeshView& mesh, const BoundingSphere& bounds, const Transform& t, Color color,
+        RasterState state = {}, const RasterTexture* texture = nullptr) {
+        Add(mesh, bounds, Mat4::FromTransform(t), color, state, texture);
+    }
+
+    // Between pipeline.Begin and Flush: sorts the draws and draws each at the LOD
+    // its screen size calls for, then clears the list. Nothing is culled here, so
+    // test draws (IsVisible, a Scene walk) before adding them.
+    void Submit(RenderPipeline& pipeline);
+    void Clear();
+    size_t Size() const { return commands.size(); }
+
+private:
+    struct Command {
+        MeshView mesh;
+        BoundingSphere bounds;
+        Mat4 model;
+        Color color;
+        RasterState state;
+        const RasterTexture* texture;
+        uint8_t* lod;
+    };
+
+    std::vector<Command> commands;
+    std::vector<uint64_t> order; // per draw, its sort key with its index in the low bits
+    ShadeScratch shading;
+};
@@ -0,0 +1,276 @@
+#include "Mesh.h"
+#include "Simplify.h"
+#include <unordered_map>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+
+BoundingSphere MeshView::Bounds() const
+{
+    if (vertexCount == 0) return { { 0,0,0 }, 0 };
+    Vec3 lo = Vertex(0), hi = lo;
+    for (size_t i = 1; i < vertexCount; i++) {
+        lo = { std::min(lo.x, x[i]), std::min(lo.y, y[i]), std::min(lo.z, z[i]) };
+        hi = { std::max(hi.x, x[i]), std::max(hi.y, y[i]), std::max(hi.z, z[i]) };
+    }
+    Vec3 c = (lo + hi) * 0.5f;
+    float r2 = 0;
+    for (size_t i = 0; i < vertexCount; i++) {
+        Vec3 d = Vertex(i) - c;
+        r2 = std::max(r2, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+    return { c, std::sqrt(r2) };
+}
+
+namespace {
+
+// a position compared bit for bit
+struct PositionKey {
+    float x, y, z;
+    bool operator==(const PositionKey& o) const { return std::memcmp(this, &o, sizeof(PositionKey)) == 0; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        uint32_t b[3];
+        std::memcpy(b, &k, sizeof(b));
+        return (size_t)(b[0] * 73856093u ^ b[1] * 19349663u ^ b[2] * 83492791u);
+    }
+};
+
+} // namespace
+
+Mesh Mesh::FromTriangles(const std::vector<Triangle>& triangles)
+{
+    Mesh mesh;
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+    auto index = [&](const Vec3& v) {
+        auto it = lookup.try_emplace({ v.x, v.y, v.z }, (uint32_t)mesh.vertices.Size());
+        if (it.second) mesh.vertices.Add(v);
+        return it.first->second;
+    };
+
+    for (const Triangle& tri : triangles) {
+        uint32_t a = index(tri.v0);
+        uint32_t b = index(tri.v1);
+        uint32_t c = index(tri.v2);
+        mesh.AddTriangle(a, b, c);
+    }
+    return mesh;
+}
+
+// Tipsify (Sander, Nehab, Barczak 2007): fan out from the current vertex, then
+// move to whichever candidate is still likely in cache and has work left.
+static std::vector<uint32_t> Tipsify(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+    const size_t triCount = indices.size() / 3;
+
+    // vertex -> triangles adjacency, stored flat
+    std::vector<uint32_t> offset(vertexCount + 1, 0);
+    for (uint32_t v : indices) offset[v + 1]++;
+    for (size_t v = 0; v < vertexCount; v++) offset[v + 1] += offset[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) live[v] = offset[v + 1] - offset[v];
+
+    std::vector<int64_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+
+    int64_t stamp = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t current = vertexCount ? 0 : -1;
+
+    while (current >= 0) {
+        candidates.clear();
+        for (uint32_t a = offset[current]; a < offset[current + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                out.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (stamp - cacheTime[v] > cacheSize) cacheTime[v] = stamp++;
+            }
+            emitted[t] = true;
+        }
+
+        // best candidate: still has live triangles, and will still be cached after fanning it
+        int64_t next = -1, bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int64_t priority = 0;
+            if (stamp - cacheTime[v] + 2 * (int64_t)live[v] <= cacheSize) priority = stamp - cacheTime[v];
+            if (priority > bestPriority) { bestPriority = priority; next = v; }
+        }
+
+        if (next < 0) {
+            while (!deadEnd.empty() && next < 0) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) next = v;
+            }
+            while (next < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) next = (int64_t)cursor;
+                cursor++;
+            }
+        }
+        current = next;
+    }
+    return out;
+}
+
+// normals are numbered like the vertices and triangles they were computed for
+static void DropNormals(Mesh& m)
+{
+    m.normals = VertexBuffer();
+    m.faceNormals.clear();
+    m.lodFaceNormals.clear();
+}
+
+// Texture coordinates renumbered like the vertices: old vertex i becomes remap[i]
+// of count, skipping those remapped to UINT32_MAX
+static void RemapCoords(std::vector<float>& coords, const std::vector<uint32_t>& remap, size_t count)
+{
+    if (coords.size() != remap.size()) {
+        coords.clear();
+        return;
+    }
+    std::vector<float> out(count);
+    for (size_t i = 0; i < remap.size(); i++)
+        if (remap[i] != UINT32_MAX) out[remap[i]] = coords[i];
+    coords = std::move(out);
+}
+
+void Mesh::OptimizeVertexCache(int cacheSize)
+{
+    const size_t vertexCount = vertices.Size();
+    if (indices.empty() || vertexCount == 0) return;
+
+    indices = Tipsify(indices, vertexCount, cacheSize);
+    lodIndices.clear();
+    lods.clear();
+    DropNormals(*this);
+
+    // renumber in first-use order
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(vertexCount, unused);
+    VertexBuffer ordered;
+    for (uint32_t& i : indices) {
+        if (remap[i] == unused) {
+            remap[i] = (uint32_t)ordered.Size();
+            ordered.Add(vertices.Get(i));
+        }
+        i = remap[i];
+    }
+    vertices = std::move(ordered);
+    RemapCoords(texU, remap, vertices.Size());
+    RemapCoords(texV, remap, vertices.Size());
+}
+
+void Mesh::BuildLods(size_t minTriangles, size_t maxLevels)
+{
+    lodIndices.clear();
+    lods.clear();
+    DropNormals(*this);
+    std::vector<SimplifiedLevel> levels = SimplifyChain(vertices, indices, minTriangles, maxLevels);
+    if (levels.empty()) return;
+
+    const size_t vertexCount = vertices.Size();
+    for (SimplifiedLevel& level : levels)
+        level.indices = Tipsify(level.indices, vertexCount, 16); // OptimizeVertexCache's default cache size
+
+    // the coarsest level each vertex appears in; vertices are then ordered
+    // coarsest first, so level L draws from a prefix of the buffer. Within the
+    // vertices that first appear at level L they go in first-use order of L's
+    // triangles, as OptimizeVertexCache left them for the full mesh.
+    std::vector<uint32_t> coarsest(vertexCount, 0);
+    for (size_t l = 0; l < levels.size(); l++)
+        for (uint32_t v : levels[l].indices) coarsest[v] = (uint32_t)l + 1;
+
+    const uint32_t unassigned = UINT32_MAX;
+    std::vector<uint32_t> remap(vertexCount, unassigned);
+    std::vector<uint32_t> prefix(levels.size() + 1);
+    VertexBuffer ordered;
+    for (size_t l = levels.size() + 1; l-- > 0;) {
+        const std::vector<uint32_t>& used = l == 0 ? indices : levels[l - 1].indices;
+        for (uint32_t v : used) {
+            if (coarsest[v] != l || remap[v] != unassigned) continue;
+            remap[v] = (uint32_t)ordered.Size();
+            ordered.Add(vertices.Get(v));
+        }
+        prefix[l] = (uint32_t)ordered.Size();
+    }
+    // vertices no level uses (none after OptimizeVertexCache) keep a slot at the end
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] != unassigned) continue;
+        remap[v] = (uint32_t)ordered.Size();
+        ordered.Add(vertices.Get(v));
+    }
+    vertices = std::move(ordered);
+    RemapCoords(texU, remap, vertexCount);
+    RemapCoords(texV, remap, vertexCount);
+    for (uint32_t& i : indices) i = remap[i];
+
+    for (size_t l = 0; l < levels.size(); l++) {
+        std::vector<uint32_t>& level = levels[l].indices;
+        for (uint32_t& i : level) i = remap[i];
+        lods.push_back({ (uint32_t)lodIndices.size(), (uint32_t)level.size(), prefix[l + 1], levels[l].error });
+        lodIndices.insert(lodIndices.end(), level.begin(), level.end());
+    }
+}
+
+// Unit normal of triangle tri, zero when it has no area
+static Vec3 FaceNormal(const VertexBuffer& v, const uint32_t* tri)
+{
+    Vec3 a = v.Get(tri[1]) - v.Get(tri[0]), b = v.Get(tri[2]) - v.Get(tri[0]);
+    Vec3 n = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+    return len > 0 ? n * (1.0f / len) : Vec3{ 0,0,0 };
+}
+
+void Mesh::ComputeNormals()
+{
+    faceNormals.resize(TriangleCount());
+    for (size_t t = 0; t < faceNormals.size(); t++) faceNormals[t] = FaceNormal(vertices, &indices[t * 3]);
+    lodFaceNormals.resize(lodIndices.size() / 3);
+    for (size_t t = 0; t < lodFaceNormals.size(); t++) lodFaceNormals[t] = FaceNormal(vertices, &lodIndices[t * 3]);
+
+    // vertices at one position (split along texture seams) add into one sum, so
+    // they get the same normal and the seam does not show in the shading
+    const size_t vertexCount = vertices.Size();
+    std::vector<uint32_t> slot(vertexCount);
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+    for (size_t i = 0; i < vertexCount; i++)
+        slot[i] = lookup.try_emplace({ vertices.x[i], vertices.y[i], vertices.z[i] }, (uint32_t)lookup.size()).first->second;
+    std::vector<Vec3> sum(lookup.size(), Vec3{ 0,0,0 });
+    for (size_t t = 0; t < faceNormals.size(); t++) {
+        const uint32_t* tri = &indices[t * 3];
+        for (int k = 0; k < 3; k++) {
+            Vec3 p = vertices.Get(tri[k]);
+            Vec3 a = vertices.Get(tri[(k + 1) % 3]) - p, b = vertices.Get(tri[(k + 2) % 3]) - p;
+            float la = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z), lb = std::sqrt(b.x * b.x + b.y * b.y + b.z * b.z);
+            if (!(la > 0 && lb > 0)) continue;
+            float cosine = (a.x * b.x + a.y * b.y + a.z * b.z) / (la * lb);
+            uint32_t s = slot[tri[k]];
+            sum[s] = sum[s] + faceNormals[t] * std::acos(std::clamp(cosine, -1.0f, 1.0f));
+        }
+    }
+
+    normals = VertexBuffer();
+    normals.x.resize(vertexCount); normals.y.resize(vertexCount); normals.z.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const Vec3& n = sum[slot[i]];
+        float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        float inv = len > 0 ? 1.0f / len : 0.0f;
+        normals.x[i] = n.x * inv; normals.y[i] = n.y * inv; normals.z[i] = n.z * inv;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Types.h"
+#include "../render/VertexStage.h"
+
+// One simplified level of a mesh: indexCount indices starting at indexOffset in
+// the mesh's LOD index list, using only its first vertexCount vertices. error is
+// the furthest any original vertex lies from the simplified surface, in model units.
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    float error;
+};
+
+// Read-only view of indexed mesh data, pointing into a Mesh or straight into a
+// mapped cache file
+struct MeshView {
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+    size_t vertexCount = 0;
+    const uint32_t* indices = nullptr;
+    size_t indexCount = 0;
+    const uint32_t* lodIndices = nullptr;
+    const MeshLod* lods = nullptr; // coarser levels, finest first
+    size_t lodCount = 0;
+    // unit normals (Mesh::ComputeNormals), null when the mesh has none: per vertex,
+    // shared by every level, and per triangle of indices and of lodIndices
+    const float* nx = nullptr;
+    const float* ny = nullptr;
+    const float* nz = nullptr;
+    const Vec3* faceNormals = nullptr;
+    const Vec3* lodFaceNormals = nullptr;
+    // texture coordinates per vertex, null when the mesh has none
+    const float* texU = nullptr;
+    const float* texV = nullptr;
+
+    Vec3 Vertex(size_t i) const { return { x[i], y[i], z[i] }; }
+    size_t TriangleCount() const { return indexCount / 3; }
+
+    // Levels counted with the full mesh as 0; the error of level i is LevelError(i)
+    size_t LevelCount() const { return lodCount + 1; }
+    float LevelError(size_t level) const { return level == 0 ? 0.0f : lods[level - 1].error; }
+    MeshView Level(size_t level) const {
+        if (level == 0) return *this;
+        const MeshLod& l = lods[level - 1];
+        MeshView v;
+        v.x = x; v.y = y; v.z = z;
+        v.vertexCount = l.vertexCount;
+        v.indices = lodIndices + l.indexOffset;
+        v.indexCount = l.indexCount;
+        v.nx = nx; v.ny = ny; v.nz = nz;
+        v.texU = texU; v.texV = texV;
+        v.faceNormals = lodFaceNormals ? lodFaceNormals + l.indexOffset / 3 : nullptr;
+        return v;
+    }
+
+    // Sphere around the vertex bounding box; not minimal, but one pass
+    BoundingSphere Bounds() const;
+};
+
+// Indexed triangle mesh: each shared position is stored (and transformed) once
+struct Mesh {
+    VertexBuffer vertices;
+    std::vector<uint32_t> indices; // three per triangle
+    std::vector<uint32_t> lodIndices; // every simplified level's triangles, back to back
+    std::vector<MeshLod> lods;
+    VertexBuffer normals;            // per vertex; empty until ComputeNormals
+    std::vector<Vec3> faceNormals;   // per triangle of indices
+    std::vector<Vec3> lodFaceNormals; // per triangle of lodIndices
+    std::vector<float> texU, texV;   // per vertex, or empty; renumbered with the vertices
+
+    size_t TriangleCount() const { return indices.size() / 3; }
+    MeshView View() const {
+        MeshView v = { vertices.x.data(), vertices.y.data(), vertices.z.data(), vertices.Size(), indices.data(), indices.size(),
+            lodIndices.data(), lods.data(), lods.size() };
+        if (normals.Size() == vertices.Size() && faceNormals.size() == TriangleCount()) {
+            v.nx = normals.x.data(); v.ny = normals.y.data(); v.nz = normals.z.data();
+            v.faceNormals = faceNormals.data();
+            v.lodFaceNormals = lodFaceNormals.data();
+        }
+        if (texU.size() == vertices.Size() && texV.size() == vertices.Size()) {
+            v.texU = texU.data(); v.texV = texV.data();
+        }
+        return v;
+    }
+    void AddTriangle(uint32_t a, uint32_t b, uint32_t c) {
+        indices.push_back(a); indices.push_back(b); indices.push_back(c);
+    }
+
+    // Merges bit-identical positions; triangle order is kept
+    static Mesh FromTriangles(const std::vector<Triangle>& triangles);
+
+    // Reorders triangles for the post-transform cache (Tipsify), then renumbers
+    // vertices in first-use order so fetches walk memory forwards. Drops unused
+    // vertices, and any LODs and normals along with the numbering they relied on.
+    void OptimizeVertexCache(int cacheSize = 16);
+
+    // Builds a chain of simplified levels by quadric error edge collapse, each
+    // about half the triangles of the one before, down to minTriangles. Collapses
+    // keep one of their two vertices, so every level draws from the same vertex
+    // buffer; vertices are renumbered so each level only uses a prefix of it,
+    // which drops any normals.
+    void BuildLods(size_t minTriangles = 64, size_t maxLevels = 8);
+
+    // Unit face normals for every level, and smooth vertex normals from the full
+    // mesh: the normals of the triangles around a vertex, each weighted by its
+    // corner angle there, so how a surface happens to be split does not tilt them.
+    // Vertices at the same position share theirs. Run once the vertex order is final.
+    void ComputeNormals();
+};
@@ -1,123 +1,123 @@
 #pragma once
 #include "Types.h"
+#include "Mesh.h"
+#include "Shading.h"
+#include "../render/RenderPipeline.h"
+#include "../io/OBJParser.h"
+#include "../io/FBXParser.h"
+#include "../io/MeshCache.h"
+#include "../io/MappedFile.h"
+#include "../io/Image.h"
+#include "../render/Texture.h"
 #include <vector>
+#include <span>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <unordered_map>
 #include <cmath>
 #include <algorithm>
 
+// Loads a model from OBJ or binary FBX (picked by the file's contents)
 class OBJLoader {
 public:
     Transform t;
-    std::vector<Triangle> triangles;
+    Mesh mesh; // empty when the geometry comes from the cache
 
     OBJLoader(const std::string& path, const Vec3& rotation = { 0,0,0 }, float scale = 1.0f, const Vec3& pos = { 0,0,0 }) {
         t.rotation = rotation;
         t.scale = scale;
         t.pos = pos;
-        LoadOBJ(path);
+        LoadModel(path);
+        bounds = GetMesh().Bounds();
     }
 
-    void Draw(int* framebuffer, float* zbuffer, int width, int height, Color baseColor) {
-        Draw(t, framebuffer, zbuffer, width, height, baseColor);
+    // Geometry to draw: the mapped cache if it was valid, otherwise the parsed mesh
+    MeshView GetMesh() const {
+        return cache.IsOpen() ? cache.View() : mesh.View();
     }
 
-    void Draw(const Transform& trans, int* framebuffer, float* zbuffer, int width, int height, Color baseColor) {
-        for (auto& tri : triangles) {
-            Vec3 v0 = RotateVertex(tri.v0, trans.rotation) * trans.scale + trans.pos;
-            Vec3 v1 = RotateVertex(tri.v1, trans.rotation) * trans.scale + trans.pos;
-            Vec3 v2 = RotateVertex(tri.v2, trans.rotation) * trans.scale + trans.pos;
+    const BoundingSphere& GetBounds() const { return bounds; }
 
-            Vec3 p0 = ProjectVertex(v0, width, height);
-            Vec3 p1 = ProjectVertex(v1, width, height);
-            Vec3 p2 = ProjectVertex(v2, width, height);
-
-            Vec3 normal = Cross(v1 - v0, v2 - v0);
-            float len = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
-            if (len == 0) continue;
-
-            float intensity = std::max(0.1f, -normal.z / len); // simple Lambert
-            Color shaded = { (unsigned char)(baseColor.r * intensity),
-                            (unsigned char)(baseColor.g * intensity),
-                            (unsigned char)(baseColor.b * intensity) };
-            DrawTriangle(framebuffer, zbuffer, width, height, p0, p1, p2, shaded);
-        }
+    // Image (PNG or PPM) drawn across the model by its texture coordinates in place
+    // of the base color; false, leaving any earlier texture, if it cannot be read
+    bool LoadTexture(const std::string& path) {
+        Image image;
+        if (!ReadImage(path, image)) return false;
+        texture = Texture(image.rgb.data(), image.width, image.height);
+        return true;
     }
+    const Texture& GetTexture() const { return texture; }
 
-private:
-    void LoadOBJ(const std::string& file) {
-        std::ifstream f(file);
-        if (!f.is_open()) return;
-
-        std::vector<Vec3> verts;
-        std::string line;
-        while (std::getline(f, line)) {
-            std::istringstream iss(line);
-            std::string prefix; iss >> prefix;
-            if (prefix == "v") {
-                Vec3 v; iss >> v.x >> v.y >> v.z;
-                verts.push_back(v);
-            }
-            else if (prefix == "f") {
-                std::vector<int> idx;
-                std::string s; while (iss >> s) {
-                    int i = std::stoi(s.substr(0, s.find('/'))) - 1;
-                    idx.push_back(i);
-                }
-                for (size_t i = 1; i + 1 < idx.size(); i++)
-                    triangles.push_back({ verts[idx[0]], verts[idx[i]], verts[idx[i + 1]] });
-            }
-        }
+    void Draw(RenderPipeline& pipeline, Color baseColor) {
+        Draw(t, pipeline, baseColor);
     }
 
-    Vec3 RotateVertex(const Vec3& v, const Vec3& r) {
-        Vec3 res = v;
-        float cx = cos(r.x), sx = sin(r.x);
-        float cy = cos(r.y), sy = sin(r.y);
-        float cz = cos(r.z), sz = sin(r.z);
-
-        float y = res.y * cx - res.z * sx; float z = res.y * sx + res.z * cx; res.y = y; res.z = z;
-        float x = res.x * cy + res.z * sy; z = -res.x * sy + res.z * cy; res.x = x; res.z = z;
-        x = res.x * cz - res.y * sz; y = res.x * sz + res.y * cz; res.x = x; res.y = y;
-        return res;
+    void Draw(const Transform& trans, RenderPipeline& pipeline, Color baseColor) {
+        Mat4 model = Mat4::FromTransform(trans);
+        if (!pipeline.IsVisible(model, bounds)) return;
+        MeshView view = GetMesh();
+        lod = SelectLod(view, ModelPixelsPerUnit(pipeline, model, bounds), lod);
+        DrawShaded(pipeline, view.Level(lod), model, baseColor, shading, texture.Raster());
     }
 
-    Vec3 ProjectVertex(const Vec3& v, int w, int h, float scale = 100.0f) {
-        return { v.x * scale + w / 2.0f, v.y * scale + h / 2.0f, v.z };
+    // One draw of many copies: the mesh is read once per group of instances
+    void DrawInstanced(std::span<const Transform> instances, RenderPipeline& pipeline, Color baseColor) {
+        DrawShadedInstances(pipeline, GetMesh(), bounds, instances, baseColor, instanceScratch, texture.Raster());
     }
 
-    Vec3 Cross(const Vec3& a, const Vec3& b) {
-        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
-    }
-
-    void DrawTriangle(int* fb, float* zb, int w, int h, const Vec3& v0, const Vec3& v1, const Vec3& v2, Color c) {
-        auto Edge = [](const Vec3& a, const Vec3& b, const Vec3& p) {return (p.x - a.x) * (b.y - a.y) - (p.y - a.y) * (b.x - a.x); };
-
-        int minX = std::max(0, (int)std::floor(std::min({ v0.x,v1.x,v2.x })));
-        int maxX = std::min(w - 1, (int)std::ceil(std::max({ v0.x,v1.x,v2.x })));
-        int minY = std::max(0, (int)std::floor(std::min({ v0.y,v1.y,v2.y })));
-        int maxY = std::min(h - 1, (int)std::ceil(std::max({ v0.y,v1.y,v2.y })));
+private:
+    ShadeScratch shading; // rebuilt each Draw
+    InstanceScratch instanceScratch;
+    Texture texture;
+    MeshCache cache;
+    BoundingSphere bounds;
+    size_t lod = 0; // level drawn last, for SelectLod's hysteresis
+
+    // Maps "<file>.chompmesh" when it still matches the source; otherwise parses
+    // the model, builds its LODs and rewrites the cache for next time
+    void LoadModel(const std::string& file) {
+        std::string cachePath = MeshCache::PathFor(file);
+        if (cache.Open(cachePath, file)) return;
+
+        MappedFile source;
+        if (!source.Open(file)) return;
+        {
+            ThreadPool pool;
+            if (!LoadFBX(source.Data(), source.Size(), mesh, pool)) {
+                OBJData obj;
+                ParseOBJ(source.Data(), source.Size(), obj, pool);
+                BuildMesh(obj);
+            }
+        }
+        mesh.OptimizeVertexCache();
+        mesh.BuildLods();
+        mesh.ComputeNormals();
 
-        float area = Edge(v0, v1, v2);
-        if (area == 0) return;
+        SourceStamp stamp;
+        if (MeshCache::Stamp(file, source.Data(), source.Size(), stamp))
+            MeshCache::Write(cachePath, mesh.View(), stamp); // best effort: a read-only directory just means no cache
+    }
 
-        for (int y = minY; y <= maxY; y++) {
-            for (int x = minX; x <= maxX; x++) {
-                Vec3 p = { (float)x + 0.5f,(float)y + 0.5f,0 };
-                float w0 = Edge(v1, v2, p);
-                float w1 = Edge(v2, v0, p);
-                float w2 = Edge(v0, v1, p);
-                if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                    float alpha = w0 / area, beta = w1 / area, gamma = w2 / area;
-                    float z = alpha * v0.z + beta * v1.z + gamma * v2.z;
-                    int idx = y * w + x;
-                    if (idx >= 0 && idx < w * h && z < zb[idx]) {
-                        fb[idx] = (c.r << 16) | (c.g << 8) | c.b;
-                        zb[idx] = z;
-                    }
-                }
+    // With texture coordinates, one vertex per distinct (position, coordinate)
+    // pair, so the positions split along texture seams; OBJ's v runs up the
+    // image, the sampler's down it. Without them, one vertex per position.
+    void BuildMesh(OBJData& obj) {
+        mesh.indices.resize(obj.corners.size());
+        if (obj.texU.empty()) {
+            mesh.vertices = std::move(obj.positions);
+            for (size_t i = 0; i < obj.corners.size(); i++)
+                mesh.indices[i] = (uint32_t)obj.corners[i].v;
+            return;
+        }
+        std::unordered_map<uint64_t, uint32_t> lookup;
+        for (size_t i = 0; i < obj.corners.size(); i++) {
+            const OBJCorner& c = obj.corners[i];
+            auto it = lookup.try_emplace((uint64_t)(uint32_t)c.v << 32 | (uint32_t)c.vt, (uint32_t)mesh.vertices.Size());
+            if (it.second) {
+                mesh.vertices.Add(obj.positions.Get(c.v));
+                mesh.texU.push_back(c.vt >= 0 ? obj.texU[c.vt] : 0.0f);
+                mesh.texV.push_back(c.vt >= 0 ? 1.0f - obj.texV[c.vt] : 0.0f);
             }
+            mesh.indices[i] = it.first->second;
         }
     }
 };
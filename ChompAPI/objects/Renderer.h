@@ -1,35 +1,36 @@
 #pragma once
 #include "Types.h"
+#include "../render/RenderPipeline.h"
+#include "../render/ShadowMap.h"
 #include <vector>
 #include <algorithm>
 #include <cmath>
 
 
 
+// Lit triangles. A ShadowMap handed to the constructor is kept aimed along the
+// same light, so shadows fall away from the lit sides.
 class Renderer {
 public:
-    int* framebuffer;
-    float* zbuffer;
-    int width, height;
-    Vec3 lightDir = { 0.5f, 1.0f, -0.5f };
-    float groundY = 0.0f;
+    RenderPipeline& pipeline;
 
-    Renderer(int* fb, float* zb, int w, int h)
-        : framebuffer(fb), zbuffer(zb), width(w), height(h)
+    Renderer(RenderPipeline& p, ShadowMap* shadows = nullptr)
+        : pipeline(p), shadows(shadows)
     {
-        float len = sqrt(lightDir.x * lightDir.x + lightDir.y * lightDir.y + lightDir.z * lightDir.z);
-        lightDir.x /= len; lightDir.y /= len; lightDir.z /= len;
+        SetLightDir({ 0.5f, 1.0f, -0.5f });
     }
 
+    // Towards the light, need not be normalized
+    void SetLightDir(const Vec3& dir) {
+        float len = sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+        if (len == 0) return;
+        lightDir = { dir.x / len, dir.y / len, dir.z / len };
+        if (shadows) shadows->lightDir = lightDir;
+    }
+    const Vec3& GetLightDir() const { return lightDir; }
+
     // Draw any triangle
     void Draw(const RenderTriangle& tri) {
-        // Shadow projection
-        Vec3 s0 = ProjectShadow(tri.v0);
-        Vec3 s1 = ProjectShadow(tri.v1);
-        Vec3 s2 = ProjectShadow(tri.v2);
-
-        DrawTriangle(s0, s1, s2, { 50,50,50 }); // shadow color
-
         // Lighting
         Vec3 normal = ComputeNormal(tri.v0, tri.v1, tri.v2);
         float brightness = std::max(0.0f, Dot(normal, lightDir));
@@ -39,14 +40,12 @@ public:
             (unsigned char)(tri.color.b * brightness)
         };
 
-        DrawTriangle(tri.v0, tri.v1, tri.v2, shadedColor);
+        pipeline.SubmitTriangle(tri.v0, tri.v1, tri.v2, shadedColor);
     }
 
 private:
-    Vec3 ProjectShadow(const Vec3& v) {
-        float t = (v.y - groundY) / lightDir.y;
-        return { v.x - lightDir.x * t, groundY, v.z - lightDir.z * t };
-    }
+    ShadowMap* shadows;
+    Vec3 lightDir;
 
     Vec3 ComputeNormal(const Vec3& a, const Vec3& b, const Vec3& c) {
         Vec3 U = { b.x - a.x, b.y - a.y, b.z - a.z };
@@ -60,34 +59,4 @@ private:
     float Dot(const Vec3& a, const Vec3& b) {
         return a.x * b.x + a.y * b.y + a.z * b.z;
     }
-
-    void DrawTriangle(Vec3 v0, Vec3 v1, Vec3 v2, Color color) {
-        auto Edge = [](const Vec3& a, const Vec3& b, const Vec3& c) {
-            return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
-            };
-
-        int minX = std::max(0, (int)std::floor(std::min({ v0.x,v1.x,v2.x })));
-        int maxX = std::min(width - 1, (int)std::ceil(std::max({ v0.x,v1.x,v2.x })));
-        int minY = std::max(0, (int)std::floor(std::min({ v0.y,v1.y,v2.y })));
-        int maxY = std::min(height - 1, (int)std::ceil(std::max({ v0.y,v1.y,v2.y })));
-
-        for (int y = minY; y <= maxY; y++) {
-            for (int x = minX; x <= maxX; x++) {
-                Vec3 p = { (float)x + 0.5f,(float)y + 0.5f,0 };
-                float w0 = Edge(v1, v2, p);
-                float w1 = Edge(v2, v0, p);
-                float w2 = Edge(v0, v1, p);
-                if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                    float area = Edge(v0, v1, v2);
-                    float alpha = w0 / area, beta = w1 / area, gamma = w2 / area;
-                    float z = alpha * v0.z + beta * v1.z + gamma * v2.z;
-                    int idx = y * width + x;
-                    if (z < zbuffer[idx]) {
-                        framebuffer[idx] = (color.r << 16) | (color.g << 8) | color.b;
-                        zbuffer[idx] = z;
-                    }
-                }
-            }
-        }
-    }
 };
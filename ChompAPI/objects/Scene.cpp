@@ -0,0 +1,263 @@
+#include "Scene.h"
+#include "Shading.h"
+#include "../render/Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+// leaf boxes are grown by this fraction of the object's radius on every side
+static const float LooseMargin = 0.1f;
+
+namespace {
+
+inline float Area(const Vec3& lo, const Vec3& hi)
+{
+    Vec3 d = hi - lo;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+inline Vec3 Min(const Vec3& a, const Vec3& b) { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+inline Vec3 Max(const Vec3& a, const Vec3& b) { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+
+} // namespace
+
+Scene::Box Scene::WorldBox(const Object& o) const
+{
+    Vec3 c = Mat4::FromTransform(o.transform).TransformPoint(o.bounds.center);
+    float r = o.bounds.radius * std::fabs(o.transform.scale);
+    return { { c.x - r, c.y - r, c.z - r }, { c.x + r, c.y + r, c.z + r } };
+}
+
+int32_t Scene::AllocateNode()
+{
+    if (!freeNodes.empty()) {
+        int32_t n = freeNodes.back();
+        freeNodes.pop_back();
+        return n;
+    }
+    nodes.push_back({});
+    return (int32_t)nodes.size() - 1;
+}
+
+// Recomputes boxes from node upwards, stopping at the first one that did not change
+void Scene::Refit(int32_t node)
+{
+    while (node >= 0) {
+        Node& n = nodes[node];
+        const Box& a = nodes[n.child[0]].box;
+        const Box& b = nodes[n.child[1]].box;
+        Vec3 lo = Min(a.lo, b.lo), hi = Max(a.hi, b.hi);
+        if (lo.x == n.box.lo.x && lo.y == n.box.lo.y && lo.z == n.box.lo.z &&
+            hi.x == n.box.hi.x && hi.y == n.box.hi.y && hi.z == n.box.hi.z) break;
+        n.box = { lo, hi };
+        node = n.parent;
+    }
+}
+
+// Walks down to the sibling that grows the tree's total surface area the least
+// (the branch-and-bound descent of Box2D's dynamic tree) and pairs the leaf with it
+void Scene::InsertLeaf(int32_t leaf)
+{
+    if (root < 0) {
+        root = leaf;
+        nodes[leaf].parent = -1;
+        return;
+    }
+
+    const Box box = nodes[leaf].box;
+    int32_t sibling = root;
+    while (nodes[sibling].child[0] >= 0) {
+        const Node& n = nodes[sibling];
+        float combined = Area(Min(n.box.lo, box.lo), Max(n.box.hi, box.hi));
+        // cost of a new parent here, and what descending adds to every ancestor
+        float here = 2 * combined;
+        float inherited = 2 * (combined - Area(n.box.lo, n.box.hi));
+
+        float cost[2];
+        for (int k = 0; k < 2; k++) {
+            const Node& c = nodes[n.child[k]];
+            float grown = Area(Min(c.box.lo, box.lo), Max(c.box.hi, box.hi));
+            cost[k] = (c.child[0] < 0 ? grown : grown - Area(c.box.lo, c.box.hi)) + inherited;
+        }
+        if (here < cost[0] && here < cost[1]) break;
+        sibling = n.child[cost[1] < cost[0] ? 1 : 0];
+    }
+
+    int32_t oldParent = nodes[sibling].parent;
+    int32_t parent = AllocateNode();
+    Node& p = nodes[parent];
+    p.box = { Min(nodes[sibling].box.lo, box.lo), Max(nodes[sibling].box.hi, box.hi) };
+    p.parent = oldParent;
+    p.child[0] = sibling;
+    p.child[1] = leaf;
+    p.object = 0;
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+
+    if (oldParent < 0) root = parent;
+    else {
+        Node& op = nodes[oldParent];
+        op.child[op.child[0] == sibling ? 0 : 1] = parent;
+        Refit(oldParent);
+    }
+}
+
+// Unhooks the leaf and lets its sibling take the parent's place
+void Scene::RemoveLeaf(int32_t leaf)
+{
+    if (leaf == root) {
+        root = -1;
+        return;
+    }
+    int32_t parent = nodes[leaf].parent;
+    int32_t grand = nodes[parent].parent;
+    int32_t sibling = nodes[parent].child[nodes[parent].child[0] == leaf ? 1 : 0];
+    freeNodes.push_back(parent);
+
+    nodes[sibling].parent = grand;
+    if (grand < 0) root = sibling;
+    else {
+        Node& g = nodes[grand];
+        g.child[g.child[0] == parent ? 0 : 1] = sibling;
+        Refit(grand);
+    }
+}
+
+Scene::ObjectId Scene::Add(const MeshView& mesh, const BoundingSphere& bounds, const Transform& t, Color color)
+{
+    ObjectId id;
+    if (!freeObjects.empty()) {
+        id = freeObjects.back();
+        freeObjects.pop_back();
+    }
+    else {
+        id = (ObjectId)objects.size();
+        objects.push_back({});
+    }
+    Object& o = objects[id];
+    o.mesh = mesh;
+    o.bounds = bounds;
+    o.transform = t;
+    o.color = color;
+    o.dirty = false;
+    o.lod = 0;
+
+    int32_t leaf = AllocateNode();
+    Box box = WorldBox(o);
+    float margin = LooseMargin * bounds.radius * std::fabs(t.scale);
+    nodes[leaf].box = { box.lo - Vec3{ margin, margin, margin }, box.hi + Vec3{ margin, margin, margin } };
+    nodes[leaf].child[0] = nodes[leaf].child[1] = -1;
+    nodes[leaf].object = id;
+    o.leaf = leaf;
+    InsertLeaf(leaf);
+    objectCount++;
+    return id;
+}
+
+void Scene::Remove(ObjectId id)
+{
+    Object& o = objects[id];
+    if (o.leaf < 0) return;
+    RemoveLeaf(o.leaf);
+    freeNodes.push_back(o.leaf);
+    o.leaf = -1;
+    freeObjects.push_back(id);
+    objectCount--;
+}
+
+void Scene::SetTransform(ObjectId id, const Transform& t)
+{
+    Object& o = objects[id];
+    o.transform = t;
+    if (!o.dirty) {
+        o.dirty = true;
+        moved.push_back(id);
+    }
+}
+
+void Scene::Update()
+{
+    for (ObjectId id : moved) {
+        Object& o = objects[id];
+        o.dirty = false;
+        if (o.leaf < 0) continue; // removed since it moved
+
+        Box box = WorldBox(o);
+        const Box& old = nodes[o.leaf].box;
+        bool inside = box.lo.x >= old.lo.x && box.lo.y >= old.lo.y && box.lo.z >= old.lo.z &&
+            box.hi.x <= old.hi.x && box.hi.y <= old.hi.y && box.hi.z <= old.hi.z;
+        if (inside) continue;
+        bool overlaps = box.lo.x <= old.hi.x && box.lo.y <= old.hi.y && box.lo.z <= old.hi.z &&
+            box.hi.x >= old.lo.x && box.hi.y >= old.lo.y && box.hi.z >= old.lo.z;
+
+        float margin = LooseMargin * o.bounds.radius * std::fabs(o.transform.scale);
+        Box loose = { box.lo - Vec3{ margin, margin, margin }, box.hi + Vec3{ margin, margin, margin } };
+        if (overlaps) {
+            // a short move: widen the path to the root in place
+            nodes[o.leaf].box = loose;
+            Refit(nodes[o.leaf].parent);
+        }
+        else {
+            RemoveLeaf(o.leaf);
+            nodes[o.leaf].box = loose;
+            InsertLeaf(o.leaf);
+        }
+    }
+    moved.clear();
+}
+
+// Walks the nodes whose boxes meet the camera frustum, handing each visible object to drawObject
+template <typename DrawObject>
+size_t Scene::DrawVisible(RenderPipeline& pipeline, DrawObject drawObject)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Cull);
+    Update();
+    if (root < 0) return 0;
+
+    size_t drawn = 0;
+    stack.clear();
+    stack.push_back({ root, RenderPipeline::AllPlanes });
+    while (!stack.empty()) {
+        Visit v = stack.back();
+        stack.pop_back();
+        const Node& n = nodes[v.node];
+        // a node wholly inside every plane passes its whole subtree without further tests
+        if (v.planes && !pipeline.IsBoxVisible(n.box.lo, n.box.hi, v.planes)) continue;
+
+        if (n.child[0] >= 0) {
+            stack.push_back({ n.child[1], v.planes });
+            stack.push_back({ n.child[0], v.planes });
+            continue;
+        }
+        Object& o = objects[n.object];
+        drawObject(o, Mat4::FromTransform(o.transform));
+        drawn++;
+    }
+    return drawn;
+}
+
+size_t Scene::Draw(RenderPipeline& pipeline)
+{
+    size_t drawn = DrawVisible(pipeline, [&](Object& o, const Mat4& model) {
+        drawList.Add(o.mesh, o.bounds, model, o.color, {}, nullptr, &o.lod);
+        });
+    drawList.Submit(pipeline);
+    return drawn;
+}
+
+size_t Scene::DrawDepth(RenderPipeline& pipeline)
+{
+    return DrawVisible(pipeline, [&](Object& o, const Mat4& model) {
+        MeshView view = o.mesh.Level(SelectLod(o.mesh, ModelPixelsPerUnit(pipeline, model, o.bounds), 0));
+        const TransformedVertices& tv = pipeline.TransformVertices(model, view.x, view.y, view.z, view.vertexCount);
+        pipeline.SubmitIndexed(tv, view.indices, view.indexCount, Colors::Black);
+        });
+}
+
+BoundingSphere Scene::Bounds()
+{
+    Update();
+    if (root < 0) return { { 0,0,0 }, 0 };
+    const Box& b = nodes[root].box;
+    Vec3 half = (b.hi - b.lo) * 0.5f;
+    return { b.lo + half, std::sqrt(half.x * half.x + half.y * half.y + half.z * half.z) };
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Types.h"
+#include "Mesh.h"
+#include "Shading.h"
+#include "DrawList.h"
+#include "../render/RenderPipeline.h"
+
+// Mesh instances in a dynamic bounding volume hierarchy over their world-space
+// boxes, so a frame only walks the parts of the tree the camera can see. Leaf
+// boxes are kept a little loose: small moves usually fit, larger ones refit the
+// boxes above the leaf, and an object that jumps clear of its box is reinserted.
+class Scene {
+public:
+    using ObjectId = uint32_t;
+
+    // bounds is the mesh's model-space sphere. The mesh data must outlive the object.
+    ObjectId Add(const MeshView& mesh, const BoundingSphere& bounds, const Transform& t, Color color);
+    ObjectId Add(const MeshView& mesh, const Transform& t, Color color) { return Add(mesh, mesh.Bounds(), t, color); }
+    void Remove(ObjectId id);
+
+    // Only records the change; the tree catches up at the next Draw
+    void SetTransform(ObjectId id, const Transform& t);
+    const Transform& GetTransform(ObjectId id) const { return objects[id].transform; }
+    void SetColor(ObjectId id, Color color) { objects[id].color = color; }
+    size_t Size() const { return objectCount; }
+
+    // Between pipeline.Begin and Flush: refits the tree, then draws every object
+    // whose box meets the camera frustum, at the LOD its screen size calls for,
+    // nearest first (DrawList). Returns how many were drawn.
+    size_t Draw(RenderPipeline& pipeline);
+    // Same walk for a depth-only pass (shadow casters): one color, no shading, and
+    // the LOD is picked without touching the main view's hysteresis
+    size_t DrawDepth(RenderPipeline& pipeline);
+
+    // World-space sphere around every object, loose boxes included (zero radius when empty)
+    BoundingSphere Bounds();
+
+private:
+    struct Box {
+        Vec3 lo, hi;
+    };
+    struct Node {
+        Box box;
+        int32_t parent;
+        int32_t child[2]; // -1 for leaves
+        ObjectId object;  // leaves only
+    };
+    struct Object {
+        MeshView mesh;
+        BoundingSphere bounds;
+        Transform transform;
+        Color color;
+        int32_t leaf = -1; // -1 while the slot is free
+        bool dirty = false;
+        uint8_t lod = 0;   // level drawn last, for SelectLod's hysteresis
+    };
+    struct Visit {
+        int32_t node;
+        uint8_t planes; // frustum planes the node still has to be tested against
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> freeNodes;
+    int32_t root = -1;
+    std::vector<Object> objects;
+    std::vector<ObjectId> freeObjects;
+    std::vector<ObjectId> moved;
+    size_t objectCount = 0;
+
+    std::vector<Visit> stack;    // traversal scratch
+    DrawList drawList;           // the visible objects, sorted before they are drawn
+
+    Box WorldBox(const Object& o) const;
+    int32_t AllocateNode();
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    void Refit(int32_t node);
+    void Update();
+    template <typename DrawObject>
+    size_t DrawVisible(RenderPipeline& pipeline, DrawObject drawObject);
+};
@@ -0,0 +1,187 @@
+#include "Shading.h"
+#include <algorithm>
+#include <cmath>
+
+// transformed vertices per instanced submission group (16 bytes each)
+static const size_t InstanceGroupVertices = 16384;
+// a coarser level is taken once its error is under this share of the limit
+static const float LodHysteresis = 0.75f;
+
+// Shade of a unit object-space normal under a model whose third row over its
+// uniform scale is r: the world-space normal's z, as the light points along +z
+static float Lambert(const float r[3], float nx, float ny, float nz)
+{
+    return std::max(0.1f, -(r[0] * nx + r[1] * ny + r[2] * nz));
+}
+
+static void LightRow(const Mat4& model, float r[3])
+{
+    // uniform scale: the length of any column of the model's 3x3
+    float scale = std::sqrt(model.m[0][0] * model.m[0][0] + model.m[1][0] * model.m[1][0] + model.m[2][0] * model.m[2][0]);
+    for (int j = 0; j < 3; j++) r[j] = model.m[2][j] / scale;
+}
+
+static Color Scaled(Color c, float intensity)
+{
+    return { (unsigned char)(c.r * intensity), (unsigned char)(c.g * intensity), (unsigned char)(c.b * intensity) };
+}
+
+void ShadeFlat(const MeshView& view, const Mat4& model, Color baseColor, std::vector<Color>& out)
+{
+    out.resize(view.TriangleCount());
+    if (view.faceNormals) {
+        float r[3];
+        LightRow(model, r);
+        for (size_t t = 0; t < out.size(); t++) {
+            const Vec3& n = view.faceNormals[t];
+            out[t] = Scaled(baseColor, Lambert(r, n.x, n.y, n.z));
+        }
+        return;
+    }
+
+    // uniform scale: the length of any column of the model's 3x3
+    float scale = std::sqrt(model.m[0][0] * model.m[0][0] + model.m[1][0] * model.m[1][0] + model.m[2][0] * model.m[2][0]);
+    for (size_t t = 0; t < out.size(); t++) {
+        const uint32_t* tri = &view.indices[t * 3];
+        Vec3 v0 = view.Vertex(tri[0]), v1 = view.Vertex(tri[1]), v2 = view.Vertex(tri[2]);
+        Vec3 a = v1 - v0, b = v2 - v0;
+        Vec3 normal = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+        float len = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z) * scale;
+
+        // world-space normal z is the model's third row applied to the object-space normal
+        float nz = model.m[2][0] * normal.x + model.m[2][1] * normal.y + model.m[2][2] * normal.z;
+        float intensity = len == 0 ? 0.1f : std::max(0.1f, -nz / len); // simple Lambert
+        out[t] = Scaled(baseColor, intensity);
+    }
+}
+
+void ShadeVertices(const MeshView& view, const Mat4& model, float* out)
+{
+    float r[3];
+    LightRow(model, r);
+    for (size_t i = 0; i < view.vertexCount; i++) out[i] = Lambert(r, view.nx[i], view.ny[i], view.nz[i]);
+}
+
+// The texture and its coordinates, when both are there; shades are left to the caller
+static VertexAttributes TextureAttributes(const MeshView& view, const RasterTexture* texture)
+{
+    VertexAttributes a;
+    if (texture && view.texU) {
+        a.texU = view.texU;
+        a.texV = view.texV;
+        a.texture = texture;
+    }
+    return a;
+}
+
+void DrawShaded(RenderPipeline& pipeline, const MeshView& view, const Mat4& model, Color baseColor, ShadeScratch& scratch,
+    const RasterTexture* texture, RasterState state)
+{
+    const TransformedVertices& tv = pipeline.TransformVertices(model, view.x, view.y, view.z, view.vertexCount);
+    VertexAttributes attributes = TextureAttributes(view, texture);
+    if (view.nx) {
+        scratch.vertexShade.resize(view.vertexCount);
+        ShadeVertices(view, model, scratch.vertexShade.data());
+        attributes.shade = scratch.vertexShade.data();
+    }
+    if (attributes.shade || attributes.texture) {
+        pipeline.SubmitIndexed(tv, view.indices, view.indexCount, baseColor, attributes, state);
+        return;
+    }
+    ShadeFlat(view, model, baseColor, scratch.triangleColors);
+    pipeline.SubmitIndexed(tv, view.indices, view.indexCount, scratch.triangleColors.data(), state);
+}
+
+size_t SelectLod(const MeshView& view, float pixelsPerUnit, size_t current, float maxPixels)
+{
+    size_t level = std::min(current, view.LevelCount() - 1);
+    while (level > 0 && view.LevelError(level) * pixelsPerUnit > maxPixels) level--;
+    while (level + 1 < view.LevelCount() && view.LevelError(level + 1) * pixelsPerUnit < maxPixels * LodHysteresis) level++;
+    return level;
+}
+
+float ModelPixelsPerUnit(const RenderPipeline& pipeline, const Mat4& model, const BoundingSphere& bounds)
+{
+    float scale = std::sqrt(model.m[0][0] * model.m[0][0] + model.m[1][0] * model.m[1][0] + model.m[2][0] * model.m[2][0]);
+    return pipeline.PixelsPerUnit(model.TransformPoint(bounds.center), bounds.radius * scale) * scale;
+}
+
+// One LOD's worth of visible instances
+static void DrawInstanceLevel(RenderPipeline& pipeline, const MeshView& view, Color baseColor, InstanceScratch& scratch,
+    const RasterTexture* texture)
+{
+    const size_t perGroup = std::max<size_t>(1, InstanceGroupVertices / view.vertexCount);
+    VertexAttributes attributes = TextureAttributes(view, texture);
+    if (view.nx || attributes.texture) {
+        for (size_t first = 0; first < scratch.models.size(); first += perGroup) {
+            size_t count = std::min(perGroup, scratch.models.size() - first);
+            const Mat4* models = scratch.models.data() + first;
+            const TransformedVertices& tv = pipeline.TransformInstances(models, count, view.x, view.y, view.z, view.vertexCount);
+            if (view.nx) {
+                scratch.vertexShade.resize(count * view.vertexCount);
+                for (size_t k = 0; k < count; k++) ShadeVertices(view, models[k], scratch.vertexShade.data() + k * view.vertexCount);
+                attributes.shade = scratch.vertexShade.data();
+            }
+            pipeline.SubmitInstances(tv, view.indices, view.indexCount, baseColor, attributes);
+        }
+        return;
+    }
+
+    // face normals once for every instance, unless the view has them; then each
+    // instance's shade is one row of its matrix against them
+    const size_t triCount = view.TriangleCount();
+    const Vec3* normals = view.faceNormals;
+    if (!normals) {
+        scratch.normals.resize(triCount);
+        for (size_t t = 0; t < triCount; t++) {
+            const uint32_t* tri = &view.indices[t * 3];
+            Vec3 v0 = view.Vertex(tri[0]), v1 = view.Vertex(tri[1]), v2 = view.Vertex(tri[2]);
+            Vec3 a = v1 - v0, b = v2 - v0;
+            Vec3 n = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+            float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            scratch.normals[t] = len == 0 ? Vec3{ 0,0,0 } : n * (1.0f / len);
+        }
+        normals = scratch.normals.data();
+    }
+
+    for (size_t first = 0; first < scratch.models.size(); first += perGroup) {
+        size_t count = std::min(perGroup, scratch.models.size() - first);
+        const Mat4* models = scratch.models.data() + first;
+        const TransformedVertices& tv = pipeline.TransformInstances(models, count, view.x, view.y, view.z, view.vertexCount);
+
+        scratch.shading.resize(count * triCount);
+        for (size_t k = 0; k < count; k++) {
+            float r[3];
+            LightRow(models[k], r);
+            Color* out = scratch.shading.data() + k * triCount;
+            for (size_t t = 0; t < triCount; t++) out[t] = Scaled(baseColor, Lambert(r, normals[t].x, normals[t].y, normals[t].z));
+        }
+        pipeline.SubmitInstances(tv, view.indices, view.indexCount, scratch.shading.data());
+    }
+}
+
+void DrawShadedInstances(RenderPipeline& pipeline, const MeshView& view, const BoundingSphere& bounds,
+    std::span<const Transform> instances, Color baseColor, InstanceScratch& scratch, const RasterTexture* texture)
+{
+    if (view.vertexCount == 0) return;
+    scratch.levels.resize(instances.size(), 0);
+    scratch.visible.clear();
+    scratch.visibleLevels.clear();
+    size_t used = 0; // bit per level with any instances
+    for (size_t i = 0; i < instances.size(); i++) {
+        Mat4 model = Mat4::FromTransform(instances[i]);
+        if (!pipeline.IsVisible(model, bounds)) continue;
+        scratch.levels[i] = (uint8_t)SelectLod(view, ModelPixelsPerUnit(pipeline, model, bounds), scratch.levels[i]);
+        scratch.visible.push_back(model);
+        scratch.visibleLevels.push_back(scratch.levels[i]);
+        used |= (size_t)1 << scratch.levels[i];
+    }
+
+    for (size_t level = 0; level < view.LevelCount(); level++) {
+        if (!(used & ((size_t)1 << level))) continue;
+        scratch.models.clear();
+        for (size_t k = 0; k < scratch.visible.size(); k++)
+            if (scratch.visibleLevels[k] == level) scratch.models.push_back(scratch.visible[k]);
+        DrawInstanceLevel(pipeline, view.Level(level), baseColor, scratch, texture);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "Types.h"
+#include "Mesh.h"
+#include "../render/RenderPipeline.h"
+
+// One flat Lambert shade per triangle of view under model, lit along +z in world
+// space; from the view's face normals when it has them
+void ShadeFlat(const MeshView& view, const Mat4& model, Color baseColor, std::vector<Color>& out);
+
+// Lambert intensity per vertex of a view with vertex normals, lit like ShadeFlat
+void ShadeVertices(const MeshView& view, const Mat4& model, float* out);
+
+// Level of view to draw when one model unit spans pixelsPerUnit pixels: the
+// coarsest whose error stays under maxPixels. current is the level drawn last
+// time; it is only coarsened once the next level is well under the limit, so a
+// mesh sitting at a boundary does not flicker between two levels.
+size_t SelectLod(const MeshView& view, float pixelsPerUnit, size_t current, float maxPixels = 1.0f);
+
+// Pixels per model unit for drawing something with these model-space bounds
+float ModelPixelsPerUnit(const RenderPipeline& pipeline, const Mat4& model, const BoundingSphere& bounds);
+
+// Shades reused between DrawShaded calls
+struct ShadeScratch {
+    std::vector<float> vertexShade;     // Gouraud, per vertex
+    std::vector<Color> triangleColors;  // flat, per triangle
+};
+
+// Transforms, shades and submits view: Gouraud from its vertex normals, or flat
+// per triangle for a view without them. With a texture, and texture coordinates
+// in the view, the texture takes the place of baseColor.
+void DrawShaded(RenderPipeline& pipeline, const MeshView& view, const Mat4& model, Color baseColor, ShadeScratch& scratch,
+    const RasterTexture* texture = nullptr, RasterState state = {});
+
+// Buffers reused between instanced draws
+struct InstanceScratch {
+    std::vector<uint8_t> levels; // LOD per instance, kept for hysteresis across frames
+    std::vector<Mat4> visible;   // surviving instances' model matrices
+    std::vector<uint8_t> visibleLevels;
+    std::vector<Mat4> models;    // the ones drawn at the current level
+    std::vector<Vec3> normals;   // unit object-space face normals, for views without their own
+    std::vector<Color> shading;  // per triangle per instance
+    std::vector<float> vertexShade; // per vertex per instance, for views with vertex normals
+};
+
+// Draws one copy of view per transform: instances outside the frustum are dropped
+// on their bounding sphere, the rest pick a LOD and are transformed, shaded and
+// submitted level by level, in groups sized to keep their transformed vertices in
+// cache. The LOD history follows instance positions in the span. texture is used
+// as in DrawShaded.
+void DrawShadedInstances(RenderPipeline& pipeline, const MeshView& view, const BoundingSphere& bounds,
+    std::span<const Transform> instances, Color baseColor, InstanceScratch& scratch, const RasterTexture* texture = nullptr);
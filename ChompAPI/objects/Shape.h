@@ -1,15 +1,12 @@
 #pragma once
 #include <vector>
 #include "Types.h"
+#include "Mesh.h"
+#include "../render/RenderPipeline.h"
 
 class Shape {
 public:
-    virtual void Draw(Color color, const Transform& t, int* framebuffer, float* zbuffer, int width, int height) = 0;
+    virtual void Draw(Color color, const Transform& t, RenderPipeline& pipeline) = 0;
 protected:
-    std::vector<Triangle> triangles;
-
-    Vec3 RotateVertex(const Vec3& v, const Vec3& rotation);
-    Vec3 ProjectVertex(const Vec3& v, int width, int height, float scale);
-    void DrawTriangle(int* framebuffer, float* zbuffer, int width, int height,
-        const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color);
+    Mesh mesh;
 };
@@ -0,0 +1,301 @@
+#include "Simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+// a snapshot is only worth keeping if it drops at least this share of the previous level
+static const float MinLevelReduction = 0.15f;
+// border planes count this many times over the faces next to them
+static const double BorderWeight = 10.0;
+// collapses stop once they would move the surface this share of the mesh's
+// bounding box diagonal; past that the shape is gone, whatever the count
+static const double MaxErrorShare = 0.05;
+
+namespace {
+
+// Sum of squared distances to a set of weighted planes, plus the face weight so
+// the error reads as a mean squared distance
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+    double weight = 0;
+
+    void AddPlane(double a, double b, double c, double d, double w) {
+        a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+        b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+        c2 += w * c * c; cd += w * c * d; d2 += w * d * d;
+    }
+    void Add(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd; d2 += q.d2; weight += q.weight;
+    }
+    double Error(const Vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+            + 2 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+        return weight > 0 ? std::max(0.0, e) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    double cost;
+    uint32_t from, to;
+    uint32_t fromStamp, toStamp; // stale once either vertex has changed since
+    bool reversed;               // the edge's costlier direction, queued after the other was refused
+    bool operator>(const Collapse& o) const { return cost > o.cost; }
+};
+
+inline Vec3 Cross(const Vec3& a, const Vec3& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+inline double Dot(const Vec3& a, const Vec3& b) { return (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z; }
+
+// Squared distance from p to triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+double TriangleDistance2(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+{
+    Vec3 ab = b - a, ac = c - a, ap = p - a;
+    double d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+    Vec3 q;
+    if (d1 <= 0 && d2 <= 0) q = a;
+    else {
+        Vec3 bp = p - b;
+        double d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+        Vec3 cp = p - c;
+        double d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+        double vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        if (d3 >= 0 && d4 <= d3) q = b;
+        else if (d6 >= 0 && d5 <= d6) q = c;
+        else if (vc <= 0 && d1 >= 0 && d3 <= 0) q = a + ab * (float)(d1 / (d1 - d3));
+        else if (vb <= 0 && d2 >= 0 && d6 <= 0) q = a + ac * (float)(d2 / (d2 - d6));
+        else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) q = b + (c - b) * (float)((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        else {
+            double denom = va + vb + vc;
+            if (denom <= 0) q = a; // degenerate
+            else q = a + ab * (float)(vb / denom) + ac * (float)(vc / denom);
+        }
+    }
+    Vec3 d = p - q;
+    return Dot(d, d);
+}
+
+class Simplifier {
+public:
+    Simplifier(const VertexBuffer& vertices, const std::vector<uint32_t>& indices)
+        : tris(indices), triCount(indices.size() / 3)
+    {
+        const size_t n = vertices.Size();
+        pos.resize(n);
+        Vec3 lo = { INFINITY, INFINITY, INFINITY }, hi = { -INFINITY, -INFINITY, -INFINITY };
+        for (size_t i = 0; i < n; i++) {
+            pos[i] = vertices.Get(i);
+            lo = { std::min(lo.x, pos[i].x), std::min(lo.y, pos[i].y), std::min(lo.z, pos[i].z) };
+            hi = { std::max(hi.x, pos[i].x), std::max(hi.y, pos[i].y), std::max(hi.z, pos[i].z) };
+        }
+        Vec3 diagonal = hi - lo;
+        maxCost = n ? Dot(diagonal, diagonal) * MaxErrorShare * MaxErrorShare : 0;
+        quadrics.resize(n);
+        merged.assign(n, NoVertex);
+        mergedTail.resize(n);
+        for (size_t i = 0; i < n; i++) mergedTail[i] = (uint32_t)i;
+        adjacency.resize(n);
+        stamp.assign(n, 0);
+        removed.assign(n, false);
+        border.assign(n, false);
+        alive.assign(triCount, true);
+
+        for (size_t t = 0; t < triCount; t++) {
+            for (int k = 0; k < 3; k++) adjacency[tris[t * 3 + k]].push_back((uint32_t)t);
+            Vec3 normal = Normal(t);
+            double len = std::sqrt(Dot(normal, normal));
+            if (len == 0) continue;
+            // area-weighted face plane
+            double a = normal.x / len, b = normal.y / len, c = normal.z / len;
+            double d = -(a * pos[tris[t * 3]].x + b * pos[tris[t * 3]].y + c * pos[tris[t * 3]].z);
+            Quadric q;
+            q.AddPlane(a, b, c, d, len * 0.5);
+            q.weight = len * 0.5;
+            for (int k = 0; k < 3; k++) quadrics[tris[t * 3 + k]].Add(q);
+        }
+
+        // edges used by one triangle: a plane through the edge, perpendicular to the
+        // face, keeps collapses from pulling the outline in
+        for (size_t t = 0; t < triCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = tris[t * 3 + k], b = tris[t * 3 + (k + 1) % 3];
+                if (SharedTriangles(a, b) != 1) continue;
+                border[a] = border[b] = true;
+                Vec3 edge = pos[b] - pos[a];
+                Vec3 m = Cross(edge, Normal(t));
+                double len = std::sqrt(Dot(m, m));
+                if (len == 0) continue;
+                double ma = m.x / len, mb = m.y / len, mc = m.z / len;
+                double d = -(ma * pos[a].x + mb * pos[a].y + mc * pos[a].z);
+                Quadric q;
+                q.AddPlane(ma, mb, mc, d, Dot(edge, edge) * BorderWeight);
+                quadrics[a].Add(q);
+                quadrics[b].Add(q);
+            }
+        }
+
+        for (size_t t = 0; t < triCount; t++)
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = tris[t * 3 + k], b = tris[t * 3 + (k + 1) % 3];
+                if (a < b || SharedTriangles(a, b) == 1) PushEdge(a, b); // interior edges appear twice
+            }
+    }
+
+    std::vector<SimplifiedLevel> Run(size_t minTriangles, size_t maxLevels) {
+        std::vector<SimplifiedLevel> levels;
+        size_t previous = triCount;
+        while (levels.size() < maxLevels && previous > minTriangles) {
+            size_t target = std::max(minTriangles, previous / 2);
+            while (triCount > target && !heap.empty()) {
+                Collapse c = heap.top();
+                if (c.cost > maxCost) break;
+                heap.pop();
+                if (removed[c.from] || removed[c.to] || stamp[c.from] != c.fromStamp || stamp[c.to] != c.toStamp) continue;
+                if (!CanCollapse(c.from, c.to)) {
+                    // the reverse costs at least as much, so it goes back in line
+                    if (!c.reversed && CanCollapse(c.to, c.from))
+                        heap.push({ Cost(c.to, c.from), c.to, c.from, c.toStamp, c.fromStamp, true });
+                    continue;
+                }
+                Apply(c.from, c.to);
+            }
+            if (triCount > previous * (1.0f - MinLevelReduction)) break; // ran out of valid collapses
+            levels.push_back({ AliveIndices(), (float)std::sqrt(worst) });
+            previous = triCount;
+        }
+        return levels;
+    }
+
+private:
+    std::vector<Vec3> pos;
+    std::vector<uint32_t> tris;
+    size_t triCount;
+    double maxCost;
+    std::vector<Quadric> quadrics;
+    double worst = 0; // largest squared distance Deviation has seen
+
+    // Original vertices each kept vertex stands for, as linked lists threaded
+    // through merged (the next one after v, or NoVertex) so a collapse splices
+    // one onto another in constant time
+    static constexpr uint32_t NoVertex = UINT32_MAX;
+    std::vector<uint32_t> merged, mergedTail;
+    std::vector<std::vector<uint32_t>> adjacency; // may list dead triangles
+    std::vector<uint32_t> stamp;
+    std::vector<uint8_t> removed, border, alive;
+    std::vector<uint32_t> neighbors; // Apply's scratch
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+    Vec3 Normal(size_t t) const {
+        const Vec3& a = pos[tris[t * 3]];
+        return Cross(pos[tris[t * 3 + 1]] - a, pos[tris[t * 3 + 2]] - a);
+    }
+
+    bool Contains(size_t t, uint32_t v) const {
+        return tris[t * 3] == v || tris[t * 3 + 1] == v || tris[t * 3 + 2] == v;
+    }
+
+    int SharedTriangles(uint32_t a, uint32_t b) const {
+        int n = 0;
+        for (uint32_t t : adjacency[a]) n += alive[t] && Contains(t, b);
+        return n;
+    }
+
+    // Queues the cheaper direction; the other is only tried if that one is refused
+    void PushEdge(uint32_t a, uint32_t b) {
+        Quadric q = quadrics[a];
+        q.Add(quadrics[b]);
+        double toB = q.Error(pos[b]), toA = q.Error(pos[a]);
+        if (toB <= toA) heap.push({ toB, a, b, stamp[a], stamp[b], false });
+        else heap.push({ toA, b, a, stamp[b], stamp[a], false });
+    }
+
+    double Cost(uint32_t from, uint32_t to) const {
+        Quadric q = quadrics[from];
+        q.Add(quadrics[to]);
+        return q.Error(pos[to]);
+    }
+
+    // Moving from onto to must not fold any remaining face over, and a border
+    // vertex may only slide along its own border
+    bool CanCollapse(uint32_t from, uint32_t to) const {
+        int shared = 0;
+        for (uint32_t t : adjacency[from]) {
+            if (!alive[t]) continue;
+            if (Contains(t, to)) { shared++; continue; }
+            Vec3 before = Normal(t);
+            Vec3 corners[3];
+            for (int k = 0; k < 3; k++) corners[k] = pos[tris[t * 3 + k] == from ? to : tris[t * 3 + k]];
+            Vec3 after = Cross(corners[1] - corners[0], corners[2] - corners[0]);
+            if (Dot(before, after) <= 0) return false;
+        }
+        if (shared == 0) return false;
+        return !border[from] || (border[to] && shared == 1);
+    }
+
+    void Apply(uint32_t from, uint32_t to) {
+        for (uint32_t t : adjacency[from]) {
+            if (!alive[t]) continue;
+            if (Contains(t, to)) {
+                alive[t] = false;
+                triCount--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                if (tris[t * 3 + k] == from) tris[t * 3 + k] = to;
+            adjacency[to].push_back(t);
+        }
+        adjacency[from].clear();
+        removed[from] = true;
+        quadrics[to].Add(quadrics[from]);
+        merged[mergedTail[to]] = from;
+        mergedTail[to] = mergedTail[from];
+        stamp[to]++;
+
+        // drop dead entries, then requeue every edge around the kept vertex
+        std::vector<uint32_t>& adj = adjacency[to];
+        adj.erase(std::remove_if(adj.begin(), adj.end(), [&](uint32_t t) { return !alive[t]; }), adj.end());
+        neighbors.clear();
+        for (uint32_t t : adj)
+            for (int k = 0; k < 3; k++)
+                if (tris[t * 3 + k] != to) neighbors.push_back(tris[t * 3 + k]);
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (uint32_t n : neighbors) PushEdge(to, n);
+        Deviation(to);
+    }
+
+    // Every original vertex folded into v should still lie on one of the
+    // triangles around v; the gap to the nearest of them is how far the surface
+    // moved there
+    void Deviation(uint32_t v) {
+        const std::vector<uint32_t>& adj = adjacency[v];
+        for (uint32_t o = merged[v]; o != NoVertex; o = merged[o]) {
+            double nearest = INFINITY;
+            for (uint32_t t : adj)
+                nearest = std::min(nearest, TriangleDistance2(pos[o], pos[tris[t * 3]], pos[tris[t * 3 + 1]], pos[tris[t * 3 + 2]]));
+            if (nearest < INFINITY) worst = std::max(worst, nearest);
+        }
+    }
+
+    std::vector<uint32_t> AliveIndices() const {
+        std::vector<uint32_t> out;
+        out.reserve(triCount * 3);
+        for (size_t t = 0; t < alive.size(); t++)
+            if (alive[t]) out.insert(out.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+        return out;
+    }
+};
+
+} // namespace
+
+std::vector<SimplifiedLevel> SimplifyChain(const VertexBuffer& vertices, const std::vector<uint32_t>& indices,
+    size_t minTriangles, size_t maxLevels)
+{
+    if (indices.size() / 3 <= minTriangles || maxLevels == 0) return {};
+    Simplifier s(vertices, indices);
+    return s.Run(minTriangles, maxLevels);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "../render/VertexStage.h"
+
+struct SimplifiedLevel {
+    std::vector<uint32_t> indices; // into the original vertices
+    float error;                   // furthest a removed vertex lies from the simplified surface
+};
+
+// Quadric error edge collapse (Garland & Heckbert 1997) in one pass over the
+// mesh, snapshotting a level each time the triangle count halves. Every collapse
+// keeps one of its two vertices, so levels only ever reference original vertices,
+// and the quadrics keep measuring against the original surface throughout.
+// Quadric cost only orders the collapses: a level's error is the largest
+// distance from a removed vertex to the triangles around the vertex it was
+// folded into, measured at each collapse.
+// Border edges are held in place. Levels come back finest first.
+std::vector<SimplifiedLevel> SimplifyChain(const VertexBuffer& vertices, const std::vector<uint32_t>& indices,
+    size_t minTriangles, size_t maxLevels);
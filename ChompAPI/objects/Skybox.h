@@ -1,15 +1,18 @@
 #pragma once
 #include "Types.h"
+#include "Mesh.h"
+#include "../render/RenderPipeline.h"
 #include <vector>
 
 class Skybox {
 public:
     Skybox(float size = 10.0f);
-    void Draw(const Transform& t, int* framebuffer, float* zbuffer, int width, int height);
+    // Rasterizes the cube's faces, unlit and without depth, under whatever is drawn next
+    void Draw(const Transform& t, RenderPipeline& pipeline);
+    // Fills only the pixels the frame leaves uncovered, by view direction, when the
+    // pipeline flushes; only t's rotation matters, the sky being infinitely far
+    void Fill(const Transform& t, RenderPipeline& pipeline);
 
 private:
-    std::vector<Triangle> triangles;
-    Vec3 RotateVertex(const Vec3& v, const Vec3& rot);
-    Vec3 ProjectVertex(const Vec3& v, int w, int h, float scale);
-    void DrawTriangleIgnoreZ(int* fb, int w, int h, const Vec3& v0, const Vec3& v1, const Vec3& v2, Color c);
+    Mesh mesh; // two triangles per face
 };
@@ -1,4 +1,5 @@
 #pragma once
+#include <cmath>
 
 struct Vec3 {
     float x, y, z;
@@ -18,6 +19,76 @@ struct Transform {
     float scale;
 };
 
+// Row-major 4x4 matrix acting on column vectors: p' = M * p
+struct Mat4 {
+    float m[4][4];
+
+    static Mat4 Identity() {
+        return { { {1,0,0,0}, {0,1,0,0}, {0,0,1,0}, {0,0,0,1} } };
+    }
+
+    // Rotate X, then Y, then Z, then scale, then translate (same order as the old RotateVertex)
+    static Mat4 FromTransform(const Transform& t) {
+        float cx = std::cos(t.rotation.x), sx = std::sin(t.rotation.x);
+        float cy = std::cos(t.rotation.y), sy = std::sin(t.rotation.y);
+        float cz = std::cos(t.rotation.z), sz = std::sin(t.rotation.z);
+        float s = t.scale;
+        return { {
+            { s * (cz * cy), s * (cz * sy * sx - sz * cx), s * (cz * sy * cx + sz * sx), t.pos.x },
+            { s * (sz * cy), s * (sz * sy * sx + cz * cx), s * (sz * sy * cx - cz * sx), t.pos.y },
+            { s * (-sy),     s * (cy * sx),                s * (cy * cx),                t.pos.z },
+            { 0, 0, 0, 1 }
+        } };
+    }
+
+    Mat4 operator*(const Mat4& o) const {
+        Mat4 r;
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] + m[i][2] * o.m[2][j] + m[i][3] * o.m[3][j];
+        return r;
+    }
+
+    // General inverse by cofactors; the zero matrix when this one is singular
+    Mat4 Inverse() const {
+        const float* a = &m[0][0];
+        float inv[16];
+        inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+        inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+        inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+        inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+        inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+        inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+        inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+        inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+        inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+        inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+        inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+        inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+        inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+        inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+        inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+        inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+        float det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+        float invDet = det != 0 ? 1.0f / det : 0.0f;
+        Mat4 r;
+        for (int i = 0; i < 16; i++) (&r.m[0][0])[i] = inv[i] * invDet;
+        return r;
+    }
+
+    Vec3 TransformPoint(const Vec3& v) const {
+        return { m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3],
+                 m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3],
+                 m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3] };
+    }
+};
+
+struct BoundingSphere {
+    Vec3 center;
+    float radius;
+};
+
 struct Triangle {
     Vec3 v0, v1, v2;
 };
@@ -0,0 +1,73 @@
+#pragma once
+#include "../objects/Types.h"
+
+enum class ProjectionType {
+    Orthographic,
+    Perspective
+};
+
+// View space looks down +z with +y pointing down the screen. Both projections
+// fold the viewport in, so after the divide by w, x/y are pixel coordinates and
+// z is depth in [0, 1] between nearZ and farZ.
+struct Camera {
+    Vec3 position = { 0,0,0 };
+    Vec3 rotation = { 0,0,0 };
+    ProjectionType projection = ProjectionType::Orthographic;
+    float pixelsPerUnit = 100.0f; // orthographic zoom
+    float fovY = 1.0f;            // perspective, radians
+    float nearZ = -1000.0f;
+    float farZ = 1000.0f;
+
+    static Camera Orthographic(float pixelsPerUnit = 100.0f, float nearZ = -1000.0f, float farZ = 1000.0f) {
+        Camera c;
+        c.projection = ProjectionType::Orthographic;
+        c.pixelsPerUnit = pixelsPerUnit;
+        c.nearZ = nearZ;
+        c.farZ = farZ;
+        return c;
+    }
+
+    static Camera Perspective(float fovY, float nearZ = 0.1f, float farZ = 1000.0f) {
+        Camera c;
+        c.projection = ProjectionType::Perspective;
+        c.fovY = fovY;
+        c.nearZ = nearZ;
+        c.farZ = farZ;
+        return c;
+    }
+
+    // Inverse of the camera's own rotation + translation
+    Mat4 ViewMatrix() const {
+        Mat4 m = Mat4::FromTransform({ position, rotation, 1.0f });
+        Mat4 v = Mat4::Identity();
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) v.m[i][j] = m.m[j][i];
+            v.m[i][3] = -(m.m[0][i] * position.x + m.m[1][i] * position.y + m.m[2][i] * position.z);
+        }
+        return v;
+    }
+
+    Mat4 ProjectionMatrix(int width, int height) const {
+        float cx = width / 2.0f, cy = height / 2.0f;
+        float depthScale = 1.0f / (farZ - nearZ);
+        if (projection == ProjectionType::Orthographic) {
+            return { {
+                { pixelsPerUnit, 0, 0, cx },
+                { 0, pixelsPerUnit, 0, cy },
+                { 0, 0, depthScale, -nearZ * depthScale },
+                { 0, 0, 0, 1 }
+            } };
+        }
+        float focal = cy / std::tan(fovY * 0.5f);
+        return { {
+            { focal, 0, cx, 0 },
+            { 0, focal, cy, 0 },
+            { 0, 0, farZ * depthScale, -nearZ * farZ * depthScale },
+            { 0, 0, 1, 0 }
+        } };
+    }
+
+    Mat4 ViewProjection(int width, int height) const {
+        return ProjectionMatrix(width, height) * ViewMatrix();
+    }
+};
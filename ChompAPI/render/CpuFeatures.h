@@ -0,0 +1,15 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHOMP_X86 1
+#include <immintrin.h>
+// MSVC accepts AVX2 intrinsics anywhere; GCC/Clang need the function marked
+#ifdef _MSC_VER
+#define CHOMP_TARGET_AVX2
+#else
+#define CHOMP_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// AVX2 + FMA usable on this CPU and OS (always false off x86)
+bool CpuHasAVX2();
@@ -0,0 +1,180 @@
+#include "Profiler.h"
+#include <cstdio>
+#include <algorithm>
+
+static const char* StageNames[(size_t)ProfileStage::Count] = {
+    "clear", "transform", "cull", "raster", "outline", "shadow", "present"
+};
+
+const char* ProfileStageName(ProfileStage stage)
+{
+    return stage < ProfileStage::Count ? StageNames[(size_t)stage] : "unknown";
+}
+
+ProfileStage FrameProfile::HottestStage() const
+{
+    return (ProfileStage)(std::max_element(std::begin(stageMs), std::end(stageMs)) - std::begin(stageMs));
+}
+
+Profiler& Profiler::Get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+double Profiler::Micros(Clock::time_point t) const
+{
+    return std::chrono::duration<double, std::micro>(t - epoch).count();
+}
+
+// called with the mutex held
+uint32_t Profiler::ThreadIndex()
+{
+    std::thread::id id = std::this_thread::get_id();
+    auto it = std::find(threads.begin(), threads.end(), id);
+    if (it != threads.end()) return (uint32_t)(it - threads.begin());
+    threads.push_back(id);
+    return (uint32_t)threads.size() - 1;
+}
+
+void Profiler::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    current = FrameProfile();
+    current.frame = frameCount;
+    frameStart = Clock::now();
+    if (captureFrames > 0) captureStarted = true;
+}
+
+void Profiler::EndFrame()
+{
+    Clock::time_point end = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    current.ms = std::chrono::duration<double, std::milli>(end - frameStart).count();
+    if (history.size() < HistorySize) history.push_back(current);
+    else history[historyNext] = current;
+    historyNext = (historyNext + 1) % HistorySize;
+    frameCount++;
+
+    if (captureStarted) {
+        if (events.size() < captureLimit)
+            events.push_back({ "frame", Micros(frameStart), Micros(end) - Micros(frameStart), ThreadIndex() });
+        counters.push_back({ Micros(end), current });
+        if (--captureFrames == 0) captureStarted = false;
+    }
+    current = FrameProfile();
+    current.frame = frameCount;
+    frameStart = end;
+}
+
+std::vector<FrameProfile> Profiler::GetHistory() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<FrameProfile> out;
+    out.reserve(history.size());
+    size_t first = history.size() < HistorySize ? 0 : historyNext;
+    for (size_t i = 0; i < history.size(); i++) out.push_back(history[(first + i) % history.size()]);
+    return out;
+}
+
+FrameProfile Profiler::GetLastFrame() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (history.empty()) return FrameProfile();
+    return history[(historyNext + history.size() - 1) % history.size()];
+}
+
+void Profiler::StartCapture(uint32_t frames, size_t maxEvents)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    captureFrames = frames;
+    captureStarted = false; // from the next BeginFrame, so the first frame is whole
+    captureLimit = maxEvents;
+    events.clear();
+    counters.clear();
+}
+
+bool Profiler::IsCapturing() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return captureFrames > 0;
+}
+
+void Profiler::AddTime(ProfileStage stage, Clock::time_point start, Clock::time_point end, Clock::duration self)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    current.stageMs[(size_t)stage] += std::chrono::duration<double, std::milli>(self).count();
+    if (captureStarted && events.size() < captureLimit)
+        events.push_back({ ProfileStageName(stage), Micros(start), Micros(end) - Micros(start), ThreadIndex() });
+}
+
+void Profiler::AddTriangles(uint64_t submitted, uint64_t culled, uint64_t rasterized)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    current.trianglesSubmitted += submitted;
+    current.trianglesCulled += culled;
+    current.trianglesRasterized += rasterized;
+}
+
+void Profiler::AddPixels(uint64_t tested, uint64_t written)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    current.pixelsTested += tested;
+    current.pixelsWritten += written;
+}
+
+void Profiler::AddTarget(uint64_t pixels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    current.targetPixels += pixels;
+}
+
+bool Profiler::WriteTrace(const std::string& path) const
+{
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // complete ("X") events nest by time on each thread; counters ("C") are drawn as graphs
+    std::fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    const char* sep = "";
+    for (uint32_t i = 0; i < threads.size(); i++) {
+        std::fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}", sep, i, i);
+        sep = ",\n";
+    }
+    for (const TraceEvent& e : events) {
+        std::fprintf(f, "%s{\"name\": \"%s\", \"cat\": \"chomp\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %u}",
+            sep, e.name, e.ts, e.dur, e.thread);
+        sep = ",\n";
+    }
+    for (const TraceCounters& c : counters) {
+        const FrameProfile& p = c.frame;
+        std::fprintf(f, "%s{\"name\": \"triangles\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 0, \"args\": "
+            "{\"submitted\": %llu, \"culled\": %llu, \"rasterized\": %llu}}", sep, c.ts,
+            (unsigned long long)p.trianglesSubmitted, (unsigned long long)p.trianglesCulled, (unsigned long long)p.trianglesRasterized);
+        sep = ",\n";
+        std::fprintf(f, "%s{\"name\": \"pixels\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 0, \"args\": "
+            "{\"tested\": %llu, \"written\": %llu}}", sep, c.ts,
+            (unsigned long long)p.pixelsTested, (unsigned long long)p.pixelsWritten);
+        std::fprintf(f, "%s{\"name\": \"overdraw\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 0, \"args\": {\"overdraw\": %.4f}}",
+            sep, c.ts, p.Overdraw());
+    }
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
+
+thread_local ProfileScope* ProfileScope::open = nullptr;
+
+ProfileScope::ProfileScope(ProfileStage s)
+    : stage(s), parent(open), start(Profiler::Clock::now())
+{
+    open = this;
+}
+
+ProfileScope::~ProfileScope()
+{
+    Profiler::Clock::time_point end = Profiler::Clock::now();
+    open = parent;
+    if (parent) parent->children += end - start;
+    Profiler::Get().AddTime(stage, start, end, end - start - children);
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stages a frame's time is split into. A scope counts its own time only: scopes
+// opened inside it are taken out, so the pipeline's Flush inside ShadowMap::End
+// shows up as raster, and the stages of a frame add up to no more than the frame.
+enum class ProfileStage : uint8_t {
+    Clear,
+    Transform,
+    Cull,      // culling, clipping and binning of submitted triangles, scene walks
+    Raster,
+    Outline,
+    Shadow,    // shadow map passes, their rasterization included
+    Present,   // on the presenting thread, counted in the frame being rendered meanwhile
+    Count
+};
+
+const char* ProfileStageName(ProfileStage stage);
+
+// One frame's stage times and pipeline counters, summed over every pass in it
+struct FrameProfile {
+    uint64_t frame = 0;
+    double ms = 0; // BeginFrame to EndFrame
+    double stageMs[(size_t)ProfileStage::Count] = {};
+    uint64_t trianglesSubmitted = 0;
+    uint64_t trianglesCulled = 0;     // outside the frustum, back-facing or degenerate
+    uint64_t trianglesRasterized = 0; // clipped pieces included
+    uint64_t pixelsTested = 0;
+    uint64_t pixelsWritten = 0;
+    uint64_t targetPixels = 0;        // area of every pass begun, shadow maps included
+
+    // Pixels written per target pixel
+    double Overdraw() const { return targetPixels ? (double)pixelsWritten / targetPixels : 0.0; }
+    ProfileStage HottestStage() const;
+};
+
+// Process-wide frame profiler. Scopes and counters may be recorded from any
+// thread; they land in whichever frame is open. Built in when CHOMP_PROFILE is
+// defined, otherwise the macros below compile to nothing and every frame reads
+// as zero.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    static const size_t HistorySize = 120;
+
+    static Profiler& Get();
+
+    void BeginFrame();
+    void EndFrame();
+
+    // Finished frames, oldest first, at most HistorySize of them
+    std::vector<FrameProfile> GetHistory() const;
+    FrameProfile GetLastFrame() const;
+
+    // Keeps every scope of the next frameCount frames as a trace event, up to
+    // maxEvents; a capture already running is dropped
+    void StartCapture(uint32_t frameCount, size_t maxEvents = 1 << 20);
+    bool IsCapturing() const;
+    // Chrome trace_event JSON of the last capture, for chrome://tracing or Perfetto
+    bool WriteTrace(const std::string& path) const;
+
+    void AddTime(ProfileStage stage, Clock::time_point start, Clock::time_point end, Clock::duration self);
+    void AddTriangles(uint64_t submitted, uint64_t culled, uint64_t rasterized);
+    void AddPixels(uint64_t tested, uint64_t written);
+    void AddTarget(uint64_t pixels);
+
+private:
+    struct TraceEvent {
+        const char* name;
+        double ts, dur; // microseconds since the profiler started
+        uint32_t thread;
+    };
+    struct TraceCounters {
+        double ts;
+        FrameProfile frame;
+    };
+
+    mutable std::mutex mutex;
+    Clock::time_point epoch = Clock::now();
+    FrameProfile current;
+    Clock::time_point frameStart = epoch;
+    uint64_t frameCount = 0;
+    std::vector<FrameProfile> history; // ring of HistorySize
+    size_t historyNext = 0;
+
+    uint32_t captureFrames = 0; // frames left to capture, counting the open one
+    bool captureStarted = false;
+    size_t captureLimit = 0;
+    std::vector<TraceEvent> events;
+    std::vector<TraceCounters> counters;
+    std::vector<std::thread::id> threads; // trace tids are indices into this
+
+    double Micros(Clock::time_point t) const;
+    uint32_t ThreadIndex();
+};
+
+// Times the enclosing block as stage on the calling thread
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileStage stage);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ProfileStage stage;
+    ProfileScope* parent;
+    Profiler::Clock::time_point start;
+    Profiler::Clock::duration children{};
+    static thread_local ProfileScope* open;
+};
+
+#ifdef CHOMP_PROFILE
+#define CHOMP_PROFILE_JOIN2(a, b) a##b
+#define CHOMP_PROFILE_JOIN(a, b) CHOMP_PROFILE_JOIN2(a, b)
+#define CHOMP_PROFILE_SCOPE(stage) ProfileScope CHOMP_PROFILE_JOIN(profileScope, __LINE__)(stage)
+#define CHOMP_PROFILE_BEGIN_FRAME() Profiler::Get().BeginFrame()
+#define CHOMP_PROFILE_END_FRAME() Profiler::Get().EndFrame()
+#else
+#define CHOMP_PROFILE_SCOPE(stage) ((void)0)
+#define CHOMP_PROFILE_BEGIN_FRAME() ((void)0)
+#define CHOMP_PROFILE_END_FRAME() ((void)0)
+#endif
@@ -0,0 +1,1182 @@
+#include "Rasterizer.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <bit>
+
+void SetupTriangle(RasterPrimitive& prim, RasterTexturing* texturings, const RasterDepthBias& bias)
+{
+    const Vec3* v[3] = { &prim.v0, &prim.v1, &prim.v2 };
+
+    // edge i runs opposite vertex i: w0 = Edge(v1, v2), w1 = Edge(v2, v0), w2 = Edge(v0, v1)
+    for (int i = 0; i < 3; i++) {
+        const Vec3& a = *v[(i + 1) % 3];
+        const Vec3& b = *v[(i + 2) % 3];
+        prim.edgeA[i] = b.y - a.y;
+        prim.edgeB[i] = a.x - b.x;
+        prim.edgeC[i] = -(prim.edgeA[i] * a.x + prim.edgeB[i] * a.y);
+    }
+
+    float area = prim.edgeA[2] * prim.v2.x + prim.edgeB[2] * prim.v2.y + prim.edgeC[2];
+    float invArea = 1.0f / area;
+    // on depth differences from v0 (the edge coefficients sum to zero), anchored at
+    // v0: summing whole depths times pixel-sized coefficients would bury the small
+    // depth steps across a triangle in rounding
+    float dz1 = prim.v1.z - prim.v0.z, dz2 = prim.v2.z - prim.v0.z;
+    prim.zdx = (prim.edgeA[1] * dz1 + prim.edgeA[2] * dz2) * invArea;
+    prim.zdy = (prim.edgeB[1] * dz1 + prim.edgeB[2] * dz2) * invArea;
+    prim.z0 = prim.v0.z - prim.zdx * prim.v0.x - prim.zdy * prim.v0.y;
+    prim.z0 += bias.constant + std::min(bias.slope * (std::abs(prim.zdx) + std::abs(prim.zdy)), bias.maxSlope);
+
+    // values at v0, v1, v2 -> their plane, the way depth is set up
+    auto toPlane = [&](float p[3]) {
+        float p0 = p[0], d1 = p[1] - p0, d2 = p[2] - p0;
+        float dx = (prim.edgeA[1] * d1 + prim.edgeA[2] * d2) * invArea;
+        float dy = (prim.edgeB[1] * d1 + prim.edgeB[2] * d2) * invArea;
+        p[0] = dx;
+        p[1] = dy;
+        p[2] = p0 - dx * prim.v0.x - dy * prim.v0.y;
+    };
+    if (prim.shading == RasterShading::Flat) return;
+    toPlane(prim.shade);
+
+    if (prim.shading == RasterShading::Textured) {
+        // level where the triangle's texel area over its pixel area comes nearest to 1
+        RasterTexturing& t = texturings[prim.color];
+        const RasterTexture& tex = *t.texture;
+        float u[3], v[3];
+        for (int k = 0; k < 3; k++) {
+            u[k] = t.tex[0][k] / t.tex[2][k];
+            v[k] = t.tex[1][k] / t.tex[2][k];
+        }
+        float texels = std::abs((u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]))
+            * (float)tex.levels[0].width * (float)tex.levels[0].height;
+        float lod = 0.5f * std::log2(texels / area);
+        t.mip = lod > 0.5f ? (int)std::min(lod + 0.5f, (float)(tex.levelCount - 1)) : 0;
+        for (float* p : t.tex) toPlane(p);
+    }
+}
+
+// Gouraud color: each channel of a PackColor value times scale / 256, scale being
+// the pixel's shade clamped to [0, 1] and truncated to 0..256. The SIMD versions
+// do the same integer math, red and blue side by side in 16-bit halves.
+static inline int ShadeScale(float shade)
+{
+    return (int)(std::min(std::max(shade, 0.0f), 1.0f) * 256.0f);
+}
+
+static inline int ShadeRgb(int rgb, int scale)
+{
+    // unsigned: red times 256 overflows an int
+    uint32_t c = (uint32_t)rgb, s = (uint32_t)scale;
+    return (int)((((c & 0xFF00FF) * s) >> 8) & 0xFF00FF) | (int)((((c & 0xFF00) * s) >> 8) & 0xFF00);
+}
+
+// Bilinear texture sampling, with repeat. A coordinate becomes texels * 256 and is
+// floored (clamped first, so any float converts), giving the texel in the high
+// bits and an 8-bit weight in the low ones; texels are blended in fixed point like
+// ShadeRgb. The SIMD versions do the same math, so every kernel samples alike.
+static const float TexCoordLimit = 1073741824.0f; // 2^30
+
+static inline int FloorFixed(float x)
+{
+    x = x > -TexCoordLimit ? x : -TexCoordLimit;
+    x = x < TexCoordLimit ? x : TexCoordLimit;
+    int t = (int)x;
+    return t - ((float)t > x ? 1 : 0);
+}
+
+// 3-bit coordinate spread to every other bit, for Morton order in a tile
+static inline int Spread3(int v)
+{
+    return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2);
+}
+
+static inline int TexelIndex(const RasterTextureLevel& l, int x, int y)
+{
+    return ((((y >> 3) << l.tileRowShift) + (x >> 3)) << 6) | Spread3(x & 7) | (Spread3(y & 7) << 1);
+}
+
+// a + (b - a) * f / 256 per channel, f in 0..255
+static inline uint32_t LerpRgb(uint32_t a, uint32_t b, uint32_t f)
+{
+    uint32_t rb = (((a & 0xFF00FF) * (256 - f) + (b & 0xFF00FF) * f) >> 8) & 0xFF00FF;
+    uint32_t g = (((a & 0xFF00) * (256 - f) + (b & 0xFF00) * f) >> 8) & 0xFF00;
+    return rb | g;
+}
+
+static inline int SampleTexture(const RasterTextureLevel& l, float u, float v)
+{
+    int tx = FloorFixed(u * (float)(l.width * 256) - 128.0f);
+    int ty = FloorFixed(v * (float)(l.height * 256) - 128.0f);
+    int x0 = (tx >> 8) & (l.width - 1), x1 = (x0 + 1) & (l.width - 1);
+    int y0 = (ty >> 8) & (l.height - 1), y1 = (y0 + 1) & (l.height - 1);
+    uint32_t fx = (uint32_t)tx & 255, fy = (uint32_t)ty & 255;
+    uint32_t top = LerpRgb(l.texels[TexelIndex(l, x0, y0)], l.texels[TexelIndex(l, x1, y0)], fx);
+    uint32_t bottom = LerpRgb(l.texels[TexelIndex(l, x0, y1)], l.texels[TexelIndex(l, x1, y1)], fx);
+    return (int)LerpRgb(top, bottom, fy);
+}
+
+#ifdef CHOMP_X86
+// 4 or 8 stored 16- or 32-bit values as 32-bit lanes, and back
+static inline __m128i LoadLanes4(const uint32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline __m128i LoadLanes4(const uint16_t* p) { return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()); }
+static inline void StoreLanes4(uint32_t* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+static inline void StoreLanes4(uint16_t* p, __m128i v)
+{
+    // sign-extend the low halves so the signed pack keeps them exactly
+    v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    _mm_storel_epi64((__m128i*)p, _mm_packs_epi32(v, v));
+}
+CHOMP_TARGET_AVX2 static inline __m256i LoadLanes8(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+CHOMP_TARGET_AVX2 static inline __m256i LoadLanes8(const uint16_t* p) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)); }
+CHOMP_TARGET_AVX2 static inline void StoreLanes8(uint32_t* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+CHOMP_TARGET_AVX2 static inline void StoreLanes8(uint16_t* p, __m256i v)
+{
+    _mm_storeu_si128((__m128i*)p, _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+static inline __m128i Select(__m128 mask, __m128i a, __m128i b)
+{
+    __m128i m = _mm_castps_si128(mask);
+    return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+static inline __m128i ShadeRgb4(__m128i rgb, __m128 shade)
+{
+    __m128 clamped = _mm_min_ps(_mm_max_ps(shade, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128i scale = _mm_cvttps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(256.0f)));
+    scale = _mm_or_si128(scale, _mm_slli_epi32(scale, 16));
+    __m128i rb = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(rgb, _mm_set1_epi32(0xFF00FF)), scale), 8);
+    __m128i g = _mm_mullo_epi16(_mm_srli_epi32(_mm_and_si128(rgb, _mm_set1_epi32(0xFF00)), 8), scale);
+    return _mm_or_si128(rb, _mm_and_si128(g, _mm_set1_epi32(0xFF00)));
+}
+
+CHOMP_TARGET_AVX2 static inline __m256i ShadeRgb8(__m256i rgb, __m256 shade)
+{
+    __m256 clamped = _mm256_min_ps(_mm256_max_ps(shade, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    __m256i scale = _mm256_cvttps_epi32(_mm256_mul_ps(clamped, _mm256_set1_ps(256.0f)));
+    scale = _mm256_or_si256(scale, _mm256_slli_epi32(scale, 16));
+    __m256i rb = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(rgb, _mm256_set1_epi32(0xFF00FF)), scale), 8);
+    __m256i g = _mm256_mullo_epi16(_mm256_srli_epi32(_mm256_and_si256(rgb, _mm256_set1_epi32(0xFF00)), 8), scale);
+    return _mm256_or_si256(rb, _mm256_and_si256(g, _mm256_set1_epi32(0xFF00)));
+}
+
+static inline __m128i FloorFixed4(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-TexCoordLimit)), _mm_set1_ps(TexCoordLimit));
+    __m128i t = _mm_cvttps_epi32(x);
+    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), x)));
+}
+
+static inline __m128i Spread3x4(__m128i v)
+{
+    __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2), four = _mm_set1_epi32(4);
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(v, one), _mm_slli_epi32(_mm_and_si128(v, two), 1)), _mm_slli_epi32(_mm_and_si128(v, four), 2));
+}
+
+static inline __m128i TexelIndex4(__m128i x, __m128i y, __m128i rowShift)
+{
+    __m128i seven = _mm_set1_epi32(7);
+    __m128i tile = _mm_add_epi32(_mm_sll_epi32(_mm_srli_epi32(y, 3), rowShift), _mm_srli_epi32(x, 3));
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(tile, 6), Spread3x4(_mm_and_si128(x, seven))), _mm_slli_epi32(Spread3x4(_mm_and_si128(y, seven)), 1));
+}
+
+static inline __m128i Fetch4(const uint32_t* texels, __m128i index)
+{
+    alignas(16) int i[4];
+    _mm_store_si128((__m128i*)i, index);
+    return _mm_setr_epi32((int)texels[i[0]], (int)texels[i[1]], (int)texels[i[2]], (int)texels[i[3]]);
+}
+
+static inline __m128i LerpRgb4(__m128i a, __m128i b, __m128i f)
+{
+    __m128i rbMask = _mm_set1_epi32(0xFF00FF), gMask = _mm_set1_epi32(0xFF00);
+    __m128i g = _mm_sub_epi32(_mm_set1_epi32(256), f);
+    __m128i wb = _mm_or_si128(f, _mm_slli_epi32(f, 16)), wa = _mm_or_si128(g, _mm_slli_epi32(g, 16));
+    __m128i rb = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(a, rbMask), wa), _mm_mullo_epi16(_mm_and_si128(b, rbMask), wb)), 8);
+    __m128i gg = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi32(_mm_and_si128(a, gMask), 8), wa), _mm_mullo_epi16(_mm_srli_epi32(_mm_and_si128(b, gMask), 8), wb));
+    return _mm_or_si128(rb, _mm_and_si128(gg, gMask));
+}
+
+static inline __m128i SampleTexture4(const RasterTextureLevel& l, __m128 u, __m128 v)
+{
+    __m128i tx = FloorFixed4(_mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((float)(l.width * 256))), _mm_set1_ps(128.0f)));
+    __m128i ty = FloorFixed4(_mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((float)(l.height * 256))), _mm_set1_ps(128.0f)));
+    __m128i wrapX = _mm_set1_epi32(l.width - 1), wrapY = _mm_set1_epi32(l.height - 1), one = _mm_set1_epi32(1);
+    __m128i x0 = _mm_and_si128(_mm_srai_epi32(tx, 8), wrapX), x1 = _mm_and_si128(_mm_add_epi32(x0, one), wrapX);
+    __m128i y0 = _mm_and_si128(_mm_srai_epi32(ty, 8), wrapY), y1 = _mm_and_si128(_mm_add_epi32(y0, one), wrapY);
+    __m128i fx = _mm_and_si128(tx, _mm_set1_epi32(255)), fy = _mm_and_si128(ty, _mm_set1_epi32(255));
+    __m128i shift = _mm_cvtsi32_si128(l.tileRowShift);
+    __m128i top = LerpRgb4(Fetch4(l.texels, TexelIndex4(x0, y0, shift)), Fetch4(l.texels, TexelIndex4(x1, y0, shift)), fx);
+    __m128i bottom = LerpRgb4(Fetch4(l.texels, TexelIndex4(x0, y1, shift)), Fetch4(l.texels, TexelIndex4(x1, y1, shift)), fx);
+    return LerpRgb4(top, bottom, fy);
+}
+
+CHOMP_TARGET_AVX2 static inline __m256i FloorFixed8(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-TexCoordLimit)), _mm256_set1_ps(TexCoordLimit));
+    __m256i t = _mm256_cvttps_epi32(x);
+    return _mm256_add_epi32(t, _mm256_castps_si256(_mm256_cmp_ps(_mm256_cvtepi32_ps(t), x, _CMP_GT_OQ)));
+}
+
+CHOMP_TARGET_AVX2 static inline __m256i Spread3x8(__m256i v)
+{
+    __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2), four = _mm256_set1_epi32(4);
+    return _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(v, one), _mm256_slli_epi32(_mm256_and_si256(v, two), 1)), _mm256_slli_epi32(_mm256_and_si256(v, four), 2));
+}
+
+CHOMP_TARGET_AVX2 static inline __m256i TexelIndex8(__m256i x, __m256i y, __m128i rowShift)
+{
+    __m256i seven = _mm256_set1_epi32(7);
+    __m256i tile = _mm256_add_epi32(_mm256_sll_epi32(_mm256_srli_epi32(y, 3), rowShift), _mm256_srli_epi32(x, 3));
+    return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(tile, 6), Spread3x8(_mm256_and_si256(x, seven))), _mm256_slli_epi32(Spread3x8(_mm256_and_si256(y, seven)), 1));
+}
+
+CHOMP_TARGET_AVX2 static inline __m256i LerpRgb8(__m256i a, __m256i b, __m256i f)
+{
+    __m256i rbMask = _mm256_set1_epi32(0xFF00FF), gMask = _mm256_set1_epi32(0xFF00);
+    __m256i g = _mm256_sub_epi32(_mm256_set1_epi32(256), f);
+    __m256i wb = _mm256_or_si256(f, _mm256_slli_epi32(f, 16)), wa = _mm256_or_si256(g, _mm256_slli_epi32(g, 16));
+    __m256i rb = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_and_si256(a, rbMask), wa), _mm256_mullo_epi16(_mm256_and_si256(b, rbMask), wb)), 8);
+    __m256i gg = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_srli_epi32(_mm256_and_si256(a, gMask), 8), wa), _mm256_mullo_epi16(_mm256_srli_epi32(_mm256_and_si256(b, gMask), 8), wb));
+    return _mm256_or_si256(rb, _mm256_and_si256(gg, gMask));
+}
+
+// the four texels of 8 pixels come from one gather each
+CHOMP_TARGET_AVX2 static inline __m256i SampleTexture8(const RasterTextureLevel& l, __m256 u, __m256 v)
+{
+    __m256i tx = FloorFixed8(_mm256_sub_ps(_mm256_mul_ps(u, _mm256_set1_ps((float)(l.width * 256))), _mm256_set1_ps(128.0f)));
+    __m256i ty = FloorFixed8(_mm256_sub_ps(_mm256_mul_ps(v, _mm256_set1_ps((float)(l.height * 256))), _mm256_set1_ps(128.0f)));
+    __m256i wrapX = _mm256_set1_epi32(l.width - 1), wrapY = _mm256_set1_epi32(l.height - 1), one = _mm256_set1_epi32(1);
+    __m256i x0 = _mm256_and_si256(_mm256_srai_epi32(tx, 8), wrapX), x1 = _mm256_and_si256(_mm256_add_epi32(x0, one), wrapX);
+    __m256i y0 = _mm256_and_si256(_mm256_srai_epi32(ty, 8), wrapY), y1 = _mm256_and_si256(_mm256_add_epi32(y0, one), wrapY);
+    __m256i fx = _mm256_and_si256(tx, _mm256_set1_epi32(255)), fy = _mm256_and_si256(ty, _mm256_set1_epi32(255));
+    __m128i shift = _mm_cvtsi32_si128(l.tileRowShift);
+    const int* texels = (const int*)l.texels;
+    __m256i top = LerpRgb8(_mm256_i32gather_epi32(texels, TexelIndex8(x0, y0, shift), 4), _mm256_i32gather_epi32(texels, TexelIndex8(x1, y0, shift), 4), fx);
+    __m256i bottom = LerpRgb8(_mm256_i32gather_epi32(texels, TexelIndex8(x0, y1, shift), 4), _mm256_i32gather_epi32(texels, TexelIndex8(x1, y1, shift), 4), fx);
+    return LerpRgb8(top, bottom, fy);
+}
+#endif
+
+// Depth storage per DepthFormat. The depth test compares keys: the float itself, or
+// the quantized integer for unorm formats. Passes that read depth back (sky, shadows,
+// outlines) work on keys as floats, depth / DepthPerKey, to skip the conversion.
+template <DepthFormat D> struct DepthOps;
+
+template <>
+struct DepthOps<DepthFormat::Float32> {
+    typedef float Key;
+    static constexpr float DepthPerKey = 1.0f;
+    static constexpr float KeyStep = 0.0f; // rounding of a depth to its key, in keys
+    static constexpr float FarKey = 1.0f;  // keys above it are past the far plane: nothing drawn
+
+    static Key ToKey(float z) { return z; }
+    static Key LoadKey(const void* p, size_t i) { return ((const float*)p)[i]; }
+    static void StoreKey(void* p, size_t i, Key k) { ((float*)p)[i] = k; }
+    static float KeyAt(const void* p, size_t i) { return LoadKey(p, i); }
+
+#ifdef CHOMP_X86
+    static __m128 Key4(__m128 z) { return z; }
+    static __m128 LoadKey4(const void* p, size_t i) { return _mm_loadu_ps((const float*)p + i); }
+    static __m128 Less4(__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }
+    static void StoreKey4(void* p, size_t i, __m128 mask, __m128 k, __m128 old)
+    {
+        _mm_storeu_ps((float*)p + i, _mm_or_ps(_mm_and_ps(mask, k), _mm_andnot_ps(mask, old)));
+    }
+    static __m128 KeyFloat4(const void* p, size_t i) { return LoadKey4(p, i); }
+
+    CHOMP_TARGET_AVX2 static __m256 Key8(__m256 z) { return z; }
+    CHOMP_TARGET_AVX2 static __m256 LoadKey8(const void* p, size_t i) { return _mm256_loadu_ps((const float*)p + i); }
+    CHOMP_TARGET_AVX2 static __m256 Less8(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    CHOMP_TARGET_AVX2 static void StoreKey8(void* p, size_t i, __m256 mask, __m256 k, __m256 old)
+    {
+        _mm256_storeu_ps((float*)p + i, _mm256_blendv_ps(old, k, mask));
+    }
+#endif
+};
+
+// Depth * MaxKey, truncated. Depths past the far plane take the key just above
+// MaxKey, which reads back as nothing drawn; every stored value, the clear value
+// included, is below 2^31, so keys compare as signed integers. Depths below 0 only
+// come from rounding and truncate to 0, so the SIMD keys skip that clamp.
+template <typename Stored, int MaxKey>
+struct UnormDepthOps {
+    typedef int Key;
+    static constexpr float Scale = (float)MaxKey;
+    static constexpr float DepthPerKey = 1.0f / Scale;
+    static constexpr float KeyStep = 1.0f;
+    static constexpr float FarKey = Scale;
+
+    static Key ToKey(float z)
+    {
+        float f = z * Scale;
+        f = f > 0.0f ? f : 0.0f;
+        return (int)(f < Scale + 1.0f ? f : Scale + 1.0f);
+    }
+    static Key LoadKey(const void* p, size_t i) { return ((const Stored*)p)[i]; }
+    static void StoreKey(void* p, size_t i, Key k) { ((Stored*)p)[i] = (Stored)k; }
+    static float KeyAt(const void* p, size_t i) { return (float)LoadKey(p, i); }
+
+#ifdef CHOMP_X86
+    static __m128i Key4(__m128 z)
+    {
+        return _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(z, _mm_set1_ps(Scale)), _mm_set1_ps(Scale + 1.0f)));
+    }
+    static __m128i LoadKey4(const void* p, size_t i) { return LoadLanes4((const Stored*)p + i); }
+    static __m128 Less4(__m128i a, __m128i b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a, b)); }
+    static void StoreKey4(void* p, size_t i, __m128 mask, __m128i k, __m128i old)
+    {
+        StoreLanes4((Stored*)p + i, Select(mask, k, old));
+    }
+    static __m128 KeyFloat4(const void* p, size_t i) { return _mm_cvtepi32_ps(LoadKey4(p, i)); }
+
+    CHOMP_TARGET_AVX2 static __m256i Key8(__m256 z)
+    {
+        return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(z, _mm256_set1_ps(Scale)), _mm256_set1_ps(Scale + 1.0f)));
+    }
+    CHOMP_TARGET_AVX2 static __m256i LoadKey8(const void* p, size_t i) { return LoadLanes8((const Stored*)p + i); }
+    CHOMP_TARGET_AVX2 static __m256 Less8(__m256i a, __m256i b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)); }
+    CHOMP_TARGET_AVX2 static void StoreKey8(void* p, size_t i, __m256 mask, __m256i k, __m256i old)
+    {
+        StoreLanes8((Stored*)p + i, _mm256_blendv_epi8(old, k, _mm256_castps_si256(mask)));
+    }
+#endif
+};
+
+template <> struct DepthOps<DepthFormat::Unorm24> : UnormDepthOps<uint32_t, 0xFFFFFF> {};
+template <> struct DepthOps<DepthFormat::Unorm16> : UnormDepthOps<uint16_t, 0xFFFE> {};
+
+// Color storage per ColorFormat. Colors are handled as their stored value (Pack of
+// a PackColor value) in an int, or one per 32-bit lane; a color written to many
+// pixels is splatted once in the stored width (Splat4 / Fill4).
+template <typename Stored, int HalfMask>
+struct StoredColorOps {
+    static int Load(const void* p, size_t i) { return ((const Stored*)p)[i]; }
+    static void Store(void* p, size_t i, int c) { ((Stored*)p)[i] = (Stored)c; }
+    // half of each channel
+    static int Darken(int c) { return (c >> 1) & HalfMask; }
+
+#ifdef CHOMP_X86
+    static __m128i Load4(const void* p, size_t i) { return LoadLanes4((const Stored*)p + i); }
+    static void Store4(void* p, size_t i, __m128i c) { StoreLanes4((Stored*)p + i, c); }
+    static void Blend4(void* p, size_t i, __m128 mask, __m128i c) { Store4(p, i, Select(mask, c, Load4(p, i))); }
+    static __m128i Darken4(__m128i c) { return _mm_and_si128(_mm_srli_epi32(c, 1), _mm_set1_epi32(HalfMask)); }
+    CHOMP_TARGET_AVX2 static void Blend8(void* p, size_t i, __m256 mask, __m256i c)
+    {
+        Stored* dst = (Stored*)p + i;
+        StoreLanes8(dst, _mm256_blendv_epi8(LoadLanes8(dst), c, _mm256_castps_si256(mask)));
+    }
+#endif
+};
+
+template <ColorFormat C> struct ColorOps;
+
+template <>
+struct ColorOps<ColorFormat::XRGB8888> : StoredColorOps<uint32_t, 0x7F7F7F> {
+    static int Pack(int rgb) { return rgb; }
+
+#ifdef CHOMP_X86
+    // PackColor values in 32-bit lanes to stored values, still one per 32-bit lane
+    static __m128i Pack4(__m128i rgb) { return rgb; }
+    CHOMP_TARGET_AVX2 static __m256i Pack8(__m256i rgb) { return rgb; }
+    static __m128i Splat4(int c) { return _mm_set1_epi32(c); }
+    static void Put4(void* p, size_t i, __m128i splat) { Store4(p, i, splat); }
+    static void Fill4(void* p, size_t i, __m128 mask, __m128i splat) { Blend4(p, i, mask, splat); }
+    CHOMP_TARGET_AVX2 static __m256i Splat8(int c) { return _mm256_set1_epi32(c); }
+    CHOMP_TARGET_AVX2 static void Fill8(void* p, size_t i, __m256 mask, __m256i splat)
+    {
+        __m256i* dst = (__m256i*)((uint32_t*)p + i);
+        _mm256_storeu_si256(dst, _mm256_blendv_epi8(_mm256_loadu_si256(dst), splat, _mm256_castps_si256(mask)));
+    }
+#endif
+};
+
+template <>
+struct ColorOps<ColorFormat::RGB565> : StoredColorOps<uint16_t, 0x7BEF> {
+    static int Pack(int rgb) { return ((rgb >> 8) & 0xF800) | ((rgb >> 5) & 0x07E0) | ((rgb >> 3) & 0x001F); }
+
+#ifdef CHOMP_X86
+    static __m128i Pack4(__m128i rgb)
+    {
+        return _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(rgb, 8), _mm_set1_epi32(0xF800)),
+            _mm_and_si128(_mm_srli_epi32(rgb, 5), _mm_set1_epi32(0x07E0))), _mm_and_si128(_mm_srli_epi32(rgb, 3), _mm_set1_epi32(0x001F)));
+    }
+    CHOMP_TARGET_AVX2 static __m256i Pack8(__m256i rgb)
+    {
+        return _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(rgb, 8), _mm256_set1_epi32(0xF800)),
+            _mm256_and_si256(_mm256_srli_epi32(rgb, 5), _mm256_set1_epi32(0x07E0))), _mm256_and_si256(_mm256_srli_epi32(rgb, 3), _mm256_set1_epi32(0x001F)));
+    }
+    // splats are 16-bit lanes; lane masks narrow with a signed pack, which keeps 0 and -1
+    static __m128i Splat4(int c) { return _mm_set1_epi16((short)c); }
+    static void Put4(void* p, size_t i, __m128i splat) { _mm_storel_epi64((__m128i*)((uint16_t*)p + i), splat); }
+    static void Fill4(void* p, size_t i, __m128 mask, __m128i splat)
+    {
+        __m128i* dst = (__m128i*)((uint16_t*)p + i);
+        __m128i m = _mm_packs_epi32(_mm_castps_si128(mask), _mm_castps_si128(mask));
+        _mm_storel_epi64(dst, _mm_or_si128(_mm_and_si128(m, splat), _mm_andnot_si128(m, _mm_loadl_epi64(dst))));
+    }
+    CHOMP_TARGET_AVX2 static __m128i Splat8(int c) { return _mm_set1_epi16((short)c); }
+    CHOMP_TARGET_AVX2 static void Fill8(void* p, size_t i, __m256 mask, __m128i splat)
+    {
+        __m128i* dst = (__m128i*)((uint16_t*)p + i);
+        __m256i m = _mm256_castps_si256(mask);
+        __m128i m16 = _mm_packs_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+        _mm_storeu_si128(dst, _mm_blendv_epi8(_mm_loadu_si128(dst), splat, m16));
+    }
+#endif
+};
+
+// Calls fn(DepthOps, ColorOps) with the ops for the target's formats, so passes
+// written as templates over both get a copy per combination
+template <typename Fn>
+static void WithFormats(const RasterTarget& t, Fn fn)
+{
+    auto withColor = [&](auto depth) {
+        if (t.colorFormat == ColorFormat::RGB565) fn(depth, ColorOps<ColorFormat::RGB565>());
+        else fn(depth, ColorOps<ColorFormat::XRGB8888>());
+    };
+    switch (t.depthFormat) {
+    case DepthFormat::Unorm24: withColor(DepthOps<DepthFormat::Unorm24>()); break;
+    case DepthFormat::Unorm16: withColor(DepthOps<DepthFormat::Unorm16>()); break;
+    default: withColor(DepthOps<DepthFormat::Float32>()); break;
+    }
+}
+
+// Every kernel evaluates depth at each pixel as zdx * px + (zdy * py + z0), a
+// multiply then an add (no fused multiply-add, no running sum), so the depth
+// written, and every shadow and outline test made on it later, does not depend on
+// the instruction set; smooth shades are evaluated the same way. Edge values are
+// stepped along the row, which can only change the answer for a pixel center
+// within rounding of an edge.
+
+// Pixels [xBegin, xEnd] of row y, stepping the edge values one pixel at a time.
+// Each kernel comes in a form per target format, and with WriteColor false only
+// depth is touched; Smooth and Textured kernels draw the triangles of that
+// RasterShading, tx being the textured ones' RasterTexturing.
+template <typename Depth, typename Color, bool WriteColor, bool Smooth, bool Textured>
+static void RasterSpanScalar(const RasterTarget& t, const RasterPrimitive& prim, const RasterTexturing* tx, RasterStats& stats, int y, int xBegin, int xEnd)
+{
+    float px = (float)xBegin + 0.5f, py = (float)y + 0.5f;
+    float e0 = prim.edgeA[0] * px + prim.edgeB[0] * py + prim.edgeC[0];
+    float e1 = prim.edgeA[1] * px + prim.edgeB[1] * py + prim.edgeC[1];
+    float e2 = prim.edgeA[2] * px + prim.edgeB[2] * py + prim.edgeC[2];
+    float rowZ = prim.zdy * py + prim.z0;
+    float rowS = Smooth || Textured ? prim.shade[1] * py + prim.shade[2] : 0.0f;
+    float rowU = 0, rowV = 0, rowQ = 0;
+    const RasterTextureLevel* level = nullptr;
+    if (Textured) {
+        rowU = tx->tex[0][1] * py + tx->tex[0][2];
+        rowV = tx->tex[1][1] * py + tx->tex[1][2];
+        rowQ = tx->tex[2][1] * py + tx->tex[2][2];
+        level = &tx->texture->levels[tx->mip];
+    }
+
+    const int color = Color::Pack(prim.color);
+    size_t row = t.address.Row(y);
+    uint64_t tested = 0, written = 0;
+    for (int x = xBegin; x <= xEnd; x++, px += 1.0f) {
+        if (e0 >= 0 && e1 >= 0 && e2 >= 0) {
+            float z = prim.zdx * px + rowZ;
+            typename Depth::Key key = Depth::ToKey(z);
+            size_t i = row + t.address.Column(x);
+            tested++;
+            if (!prim.state.depthTest || key < Depth::LoadKey(t.zbuffer, i)) {
+                written++;
+                if (WriteColor) {
+                    if (Textured) {
+                        float r = 1.0f / (tx->tex[2][0] * px + rowQ);
+                        int texel = SampleTexture(*level, (tx->tex[0][0] * px + rowU) * r, (tx->tex[1][0] * px + rowV) * r);
+                        Color::Store(t.framebuffer, i, Color::Pack(ShadeRgb(texel, ShadeScale(prim.shade[0] * px + rowS))));
+                    }
+                    else Color::Store(t.framebuffer, i,
+                        Smooth ? Color::Pack(ShadeRgb(prim.color, ShadeScale(prim.shade[0] * px + rowS))) : color);
+                }
+                if (prim.state.depthWrite) {
+                    Depth::StoreKey(t.zbuffer, i, key);
+                    if (WriteColor && t.objectIds) t.objectIds[i] = prim.object;
+                }
+            }
+        }
+        e0 += prim.edgeA[0]; e1 += prim.edgeA[1]; e2 += prim.edgeA[2];
+    }
+    stats.pixelsTested += tested;
+    stats.pixelsWritten += written;
+}
+
+template <typename Depth, typename Color, bool WriteColor, bool Smooth, bool Textured>
+static void RasterTriangleScalar(const RasterTarget& t, const TileRect& tile, const RasterPrimitive& prim, const RasterTexturing* tx, RasterStats& stats)
+{
+    int minX = std::max(prim.minX, tile.x0), maxX = std::min(prim.maxX, tile.x1 - 1);
+    int minY = std::max(prim.minY, tile.y0), maxY = std::min(prim.maxY, tile.y1 - 1);
+    for (int y = minY; y <= maxY; y++)
+        RasterSpanScalar<Depth, Color, WriteColor, Smooth, Textured>(t, prim, tx, stats, y, minX, maxX);
+}
+
+#ifdef CHOMP_X86
+// 4 pixels per step. Groups start on a multiple of 4 so a full group never leaves
+// the tile, nor the run of 8 contiguous pixels it lies in; a group that would
+// cross the tile's right edge is finished in scalar.
+template <typename Depth, typename Color, bool WriteColor, bool Smooth, bool Textured>
+static void RasterTriangleSSE2(const RasterTarget& t, const TileRect& tile, const RasterPrimitive& prim, const RasterTexturing* tx, RasterStats& stats)
+{
+    int minX = std::max(prim.minX, tile.x0), maxX = std::min(prim.maxX, tile.x1 - 1);
+    int minY = std::max(prim.minY, tile.y0), maxY = std::min(prim.maxY, tile.y1 - 1);
+    int startX = minX & ~3;
+
+    const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i color = Color::Splat4(Color::Pack(prim.color));
+    const __m128i rgb = _mm_set1_epi32(prim.color);
+    const __m128i object = _mm_set1_epi32((int)prim.object);
+    const __m128 four = _mm_set1_ps(4.0f);
+    __m128 a0 = _mm_set1_ps(prim.edgeA[0]), a1 = _mm_set1_ps(prim.edgeA[1]), a2 = _mm_set1_ps(prim.edgeA[2]);
+    __m128 step0 = _mm_mul_ps(a0, four), step1 = _mm_mul_ps(a1, four), step2 = _mm_mul_ps(a2, four);
+    __m128 zdx = _mm_set1_ps(prim.zdx);
+    __m128 sdx = _mm_set1_ps(prim.shade[0]);
+    __m128 udx = _mm_set1_ps(Textured ? tx->tex[0][0] : 0.0f), vdx = _mm_set1_ps(Textured ? tx->tex[1][0] : 0.0f), qdx = _mm_set1_ps(Textured ? tx->tex[2][0] : 0.0f);
+    const RasterTextureLevel* level = Textured ? &tx->texture->levels[tx->mip] : nullptr;
+    uint64_t tested = 0, written = 0;
+
+    for (int y = minY; y <= maxY; y++) {
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)startX), lane); // pixel centers stay exact
+        float py = (float)y + 0.5f;
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), _mm_set1_ps(prim.edgeB[0] * py + prim.edgeC[0]));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), _mm_set1_ps(prim.edgeB[1] * py + prim.edgeC[1]));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), _mm_set1_ps(prim.edgeB[2] * py + prim.edgeC[2]));
+        __m128 rowZ = _mm_set1_ps(prim.zdy * py + prim.z0);
+        __m128 rowS = _mm_set1_ps(Smooth || Textured ? prim.shade[1] * py + prim.shade[2] : 0.0f);
+        __m128 rowU = _mm_setzero_ps(), rowV = _mm_setzero_ps(), rowQ = _mm_setzero_ps();
+        if (Textured) {
+            rowU = _mm_set1_ps(tx->tex[0][1] * py + tx->tex[0][2]);
+            rowV = _mm_set1_ps(tx->tex[1][1] * py + tx->tex[1][2]);
+            rowQ = _mm_set1_ps(tx->tex[2][1] * py + tx->tex[2][2]);
+        }
+
+        size_t row = t.address.Row(y);
+        for (int x = startX; x <= maxX; x += 4) {
+            if (x + 4 > tile.x1) {
+                RasterSpanScalar<Depth, Color, WriteColor, Smooth, Textured>(t, prim, tx, stats, y, std::max(x, minX), maxX);
+                break;
+            }
+
+            __m128 mask = _mm_cmpge_ps(_mm_min_ps(_mm_min_ps(e0, e1), e2), zero);
+            if (int covered = _mm_movemask_ps(mask)) {
+                size_t i = row + t.address.Column(x);
+                auto key = Depth::Key4(_mm_add_ps(_mm_mul_ps(zdx, px), rowZ));
+                auto old = Depth::LoadKey4(t.zbuffer, i);
+                if (prim.state.depthTest) mask = _mm_and_ps(mask, Depth::Less4(key, old));
+                tested += std::popcount((unsigned)covered);
+                written += std::popcount((unsigned)_mm_movemask_ps(mask));
+                if (prim.state.depthWrite) Depth::StoreKey4(t.zbuffer, i, mask, key, old);
+                if (WriteColor) {
+                    if (Textured) {
+                        __m128 r = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(qdx, px), rowQ));
+                        __m128i texel = SampleTexture4(*level, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(udx, px), rowU), r), _mm_mul_ps(_mm_add_ps(_mm_mul_ps(vdx, px), rowV), r));
+                        Color::Blend4(t.framebuffer, i, mask, Color::Pack4(ShadeRgb4(texel, _mm_add_ps(_mm_mul_ps(sdx, px), rowS))));
+                    }
+                    else if (Smooth) Color::Blend4(t.framebuffer, i, mask, Color::Pack4(ShadeRgb4(rgb, _mm_add_ps(_mm_mul_ps(sdx, px), rowS))));
+                    else Color::Fill4(t.framebuffer, i, mask, color);
+                    if (t.objectIds && prim.state.depthWrite) {
+                        __m128i* ip = (__m128i*)(t.objectIds + i);
+                        _mm_storeu_si128(ip, Select(mask, object, _mm_loadu_si128(ip)));
+                    }
+                }
+            }
+
+            e0 = _mm_add_ps(e0, step0); e1 = _mm_add_ps(e1, step1); e2 = _mm_add_ps(e2, step2);
+            px = _mm_add_ps(px, four);
+        }
+    }
+    stats.pixelsTested += tested;
+    stats.pixelsWritten += written;
+}
+
+// Same walk as the SSE2 kernel, 8 pixels per step
+template <typename Depth, typename Color, bool WriteColor, bool Smooth, bool Textured>
+CHOMP_TARGET_AVX2
+static void RasterTriangleAVX2(const RasterTarget& t, const TileRect& tile, const RasterPrimitive& prim, const RasterTexturing* tx, RasterStats& stats)
+{
+    int minX = std::max(prim.minX, tile.x0), maxX = std::min(prim.maxX, tile.x1 - 1);
+    int minY = std::max(prim.minY, tile.y0), maxY = std::min(prim.maxY, tile.y1 - 1);
+    int startX = minX & ~7;
+
+    const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const auto color = Color::Splat8(Color::Pack(prim.color));
+    const __m256i rgb = _mm256_set1_epi32(prim.color);
+    const __m256 object = _mm256_castsi256_ps(_mm256_set1_epi32((int)prim.object));
+    const __m256 eight = _mm256_set1_ps(8.0f);
+    __m256 a0 = _mm256_set1_ps(prim.edgeA[0]), a1 = _mm256_set1_ps(prim.edgeA[1]), a2 = _mm256_set1_ps(prim.edgeA[2]);
+    __m256 step0 = _mm256_mul_ps(a0, eight), step1 = _mm256_mul_ps(a1, eight), step2 = _mm256_mul_ps(a2, eight);
+    __m256 zdx = _mm256_set1_ps(prim.zdx);
+    __m256 sdx = _mm256_set1_ps(prim.shade[0]);
+    __m256 udx = _mm256_set1_ps(Textured ? tx->tex[0][0] : 0.0f), vdx = _mm256_set1_ps(Textured ? tx->tex[1][0] : 0.0f), qdx = _mm256_set1_ps(Textured ? tx->tex[2][0] : 0.0f);
+    const RasterTextureLevel* level = Textured ? &tx->texture->levels[tx->mip] : nullptr;
+    uint64_t tested = 0, written = 0;
+
+    for (int y = minY; y <= maxY; y++) {
+        __m256 px = _mm256_add_ps(_mm256_set1_ps((float)startX), lane);
+        float py = (float)y + 0.5f;
+        __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), _mm256_set1_ps(prim.edgeB[0] * py + prim.edgeC[0]));
+        __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), _mm256_set1_ps(prim.edgeB[1] * py + prim.edgeC[1]));
+        __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), _mm256_set1_ps(prim.edgeB[2] * py + prim.edgeC[2]));
+        __m256 rowZ = _mm256_set1_ps(prim.zdy * py + prim.z0);
+        __m256 rowS = _mm256_set1_ps(Smooth || Textured ? prim.shade[1] * py + prim.shade[2] : 0.0f);
+        __m256 rowU = _mm256_setzero_ps(), rowV = _mm256_setzero_ps(), rowQ = _mm256_setzero_ps();
+        if (Textured) {
+            rowU = _mm256_set1_ps(tx->tex[0][1] * py + tx->tex[0][2]);
+            rowV = _mm256_set1_ps(tx->tex[1][1] * py + tx->tex[1][2]);
+            rowQ = _mm256_set1_ps(tx->tex[2][1] * py + tx->tex[2][2]);
+        }
+
+        size_t row = t.address.Row(y);
+        for (int x = startX; x <= maxX; x += 8) {
+            if (x + 8 > tile.x1) {
+                RasterSpanScalar<Depth, Color, WriteColor, Smooth, Textured>(t, prim, tx, stats, y, std::max(x, minX), maxX);
+                break;
+            }
+
+            __m256 mask = _mm256_cmp_ps(_mm256_min_ps(_mm256_min_ps(e0, e1), e2), zero, _CMP_GE_OQ);
+            if (int covered = _mm256_movemask_ps(mask)) {
+                size_t i = row + t.address.Column(x);
+                auto key = Depth::Key8(_mm256_add_ps(_mm256_mul_ps(zdx, px), rowZ));
+                auto old = Depth::LoadKey8(t.zbuffer, i);
+                if (prim.state.depthTest) mask = _mm256_and_ps(mask, Depth::Less8(key, old));
+                tested += std::popcount((unsigned)covered);
+                written += std::popcount((unsigned)_mm256_movemask_ps(mask));
+                if (prim.state.depthWrite) Depth::StoreKey8(t.zbuffer, i, mask, key, old);
+                if (WriteColor) {
+                    if (Textured) {
+                        __m256 r = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(_mm256_mul_ps(qdx, px), rowQ));
+                        __m256i texel = SampleTexture8(*level, _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(udx, px), rowU), r), _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(vdx, px), rowV), r));
+                        Color::Blend8(t.framebuffer, i, mask, Color::Pack8(ShadeRgb8(texel, _mm256_add_ps(_mm256_mul_ps(sdx, px), rowS))));
+                    }
+                    else if (Smooth) Color::Blend8(t.framebuffer, i, mask, Color::Pack8(ShadeRgb8(rgb, _mm256_add_ps(_mm256_mul_ps(sdx, px), rowS))));
+                    else Color::Fill8(t.framebuffer, i, mask, color);
+                    if (t.objectIds && prim.state.depthWrite) {
+                        float* ip = (float*)(t.objectIds + i);
+                        _mm256_storeu_ps(ip, _mm256_blendv_ps(_mm256_loadu_ps(ip), object, mask));
+                    }
+                }
+            }
+
+            e0 = _mm256_add_ps(e0, step0); e1 = _mm256_add_ps(e1, step1); e2 = _mm256_add_ps(e2, step2);
+            px = _mm256_add_ps(px, eight);
+        }
+    }
+    stats.pixelsTested += tested;
+    stats.pixelsWritten += written;
+}
+#endif
+
+typedef void (*TriangleKernel)(const RasterTarget&, const TileRect&, const RasterPrimitive&, const RasterTexturing*, RasterStats&);
+
+// One kernel per [DepthFormat][ColorFormat], then one for targets without a
+// framebuffer, then the smooth and the textured kernels per ColorFormat
+static const int DepthOnlyKernel = 2, SmoothKernels = 3, TexturedKernels = 5;
+#define CHOMP_KERNEL_ROW(kernel, depth) { \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::XRGB8888>, true, false, false>, \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::RGB565>, true, false, false>, \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::XRGB8888>, false, false, false>, \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::XRGB8888>, true, true, false>, \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::RGB565>, true, true, false>, \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::XRGB8888>, true, false, true>, \
+    kernel<DepthOps<depth>, ColorOps<ColorFormat::RGB565>, true, false, true> }
+#define CHOMP_KERNEL_TABLE(kernel) { CHOMP_KERNEL_ROW(kernel, DepthFormat::Float32), \
+    CHOMP_KERNEL_ROW(kernel, DepthFormat::Unorm24), CHOMP_KERNEL_ROW(kernel, DepthFormat::Unorm16) }
+
+struct KernelChoice {
+    TriangleKernel kernels[3][7];
+    const char* name;
+};
+
+// CHOMP_RASTER_ISA=scalar|sse2 forces a narrower kernel than the CPU supports
+static KernelChoice SelectKernel()
+{
+    const char* forced = std::getenv("CHOMP_RASTER_ISA");
+    if (forced && std::strcmp(forced, "scalar") == 0) return { CHOMP_KERNEL_TABLE(RasterTriangleScalar), "scalar" };
+#ifdef CHOMP_X86
+    if (CpuHasAVX2() && !(forced && std::strcmp(forced, "sse2") == 0)) return { CHOMP_KERNEL_TABLE(RasterTriangleAVX2), "avx2" };
+    return { CHOMP_KERNEL_TABLE(RasterTriangleSSE2), "sse2" };
+#else
+    return { CHOMP_KERNEL_TABLE(RasterTriangleScalar), "scalar" };
+#endif
+}
+
+static const KernelChoice& GetKernel()
+{
+    static const KernelChoice choice = SelectKernel();
+    return choice;
+}
+
+const char* GetRasterIsaName()
+{
+    return GetKernel().name;
+}
+
+// Bresenham walk of the whole line, writing only the pixels this tile owns
+static void RasterLine(const RasterTarget& t, const TileRect& tile, const RasterPrimitive& prim)
+{
+    int x0 = (int)prim.v0.x, y0 = (int)prim.v0.y;
+    int x1 = (int)prim.v1.x, y1 = (int)prim.v1.y;
+    int dx = std::abs(x1 - x0), dy = std::abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx - dy;
+    bool packed = t.colorFormat == ColorFormat::RGB565;
+    int color = packed ? ColorOps<ColorFormat::RGB565>::Pack(prim.color) : prim.color;
+
+    while (true) {
+        if (x0 >= tile.x0 && x0 < tile.x1 && y0 >= tile.y0 && y0 < tile.y1) {
+            size_t i = t.address(x0, y0);
+            if (packed) ColorOps<ColorFormat::RGB565>::Store(t.framebuffer, i, color);
+            else ColorOps<ColorFormat::XRGB8888>::Store(t.framebuffer, i, color);
+        }
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 > -dy) { err -= dy; x0 += sx; }
+        if (e2 < dx) { err += dx; y0 += sy; }
+    }
+}
+
+// A tile's blocks as bits of its dirty mask: bit (by * 8 + bx), tile-local
+static uint64_t BlockMask(const TileRect& tile, const TileRect& rect)
+{
+    int bx0 = (rect.x0 - tile.x0) / DepthBlockSize, bx1 = (rect.x1 - 1 - tile.x0) / DepthBlockSize;
+    int by0 = (rect.y0 - tile.y0) / DepthBlockSize, by1 = (rect.y1 - 1 - tile.y0) / DepthBlockSize;
+    uint64_t columns = ((2ull << (bx1 - bx0)) - 1) << bx0;
+    uint64_t rows = (~0ull >> (56 - 8 * (by1 - by0))) << (8 * by0);
+    return (columns * 0x0101010101010101ull) & rows;
+}
+
+template <typename Depth>
+static float MeasureBlockAs(const RasterTarget& t, int x0, int y0, int x1, int y1)
+{
+    float maxKey;
+#ifdef CHOMP_X86
+    if (x1 - x0 == 8) {
+        __m128 m = _mm_set1_ps(-INFINITY);
+        for (int y = y0; y < y1; y++) {
+            size_t i = t.address(x0, y);
+            m = _mm_max_ps(m, _mm_max_ps(Depth::KeyFloat4(t.zbuffer, i), Depth::KeyFloat4(t.zbuffer, i + 4)));
+        }
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+        maxKey = _mm_cvtss_f32(m);
+    }
+    else
+#endif
+    {
+        maxKey = -INFINITY;
+        for (int y = y0; y < y1; y++)
+            for (int x = x0; x < x1; x++) maxKey = std::max(maxKey, Depth::KeyAt(t.zbuffer, t.address(x, y)));
+    }
+    // keys round depths down
+    return (maxKey + Depth::KeyStep) * Depth::DepthPerKey;
+}
+
+// Recomputes a block's max depth from the zbuffer
+static float MeasureBlock(const RasterTarget& t, int bx, int by)
+{
+    int x0 = bx * DepthBlockSize, y0 = by * DepthBlockSize;
+    int x1 = std::min(x0 + DepthBlockSize, t.width), y1 = std::min(y0 + DepthBlockSize, t.height);
+    float maxZ;
+    switch (t.depthFormat) {
+    case DepthFormat::Unorm24: maxZ = MeasureBlockAs<DepthOps<DepthFormat::Unorm24>>(t, x0, y0, x1, y1); break;
+    case DepthFormat::Unorm16: maxZ = MeasureBlockAs<DepthOps<DepthFormat::Unorm16>>(t, x0, y0, x1, y1); break;
+    default: maxZ = MeasureBlockAs<DepthOps<DepthFormat::Float32>>(t, x0, y0, x1, y1); break;
+    }
+    t.blockMaxZ[by * t.blocksX + bx] = maxZ;
+    return maxZ;
+}
+
+// Triangle test: judges written blocks by their last measured max, which is
+// still an upper bound, so it stays cheap enough to run per triangle
+static bool AnyBlockMaybeVisible(const RasterTarget& t, const TileRect& rect, float minZ)
+{
+    int bx0 = rect.x0 / DepthBlockSize, bx1 = (rect.x1 - 1) / DepthBlockSize;
+    for (int by = rect.y0 / DepthBlockSize; by <= (rect.y1 - 1) / DepthBlockSize; by++) {
+        const float* row = t.blockMaxZ + by * t.blocksX;
+        for (int bx = bx0; bx <= bx1; bx++)
+            if (minZ < row[bx]) return true;
+    }
+    return false;
+}
+
+// Object test: remeasures written blocks as needed to prove the whole rect
+// hidden, stopping at the first block that is not
+static bool AnyBlockVisible(const RasterTarget& t, const TileRect& tile, uint64_t& dirty, const TileRect& rect, float minZ)
+{
+    for (int by = rect.y0 / DepthBlockSize; by <= (rect.y1 - 1) / DepthBlockSize; by++) {
+        for (int bx = rect.x0 / DepthBlockSize; bx <= (rect.x1 - 1) / DepthBlockSize; bx++) {
+            if (!(minZ < t.blockMaxZ[by * t.blocksX + bx])) continue;
+            uint64_t bit = 1ull << ((by - tile.y0 / DepthBlockSize) * 8 + (bx - tile.x0 / DepthBlockSize));
+            if (!(dirty & bit)) return true;
+            dirty &= ~bit;
+            if (minZ < MeasureBlock(t, bx, by)) return true;
+        }
+    }
+    return false;
+}
+
+// Forgets the max of the blocks under rect until they are next measured
+static void UnboundBlocks(const RasterTarget& t, const TileRect& rect)
+{
+    for (int by = rect.y0 / DepthBlockSize; by <= (rect.y1 - 1) / DepthBlockSize; by++)
+        for (int bx = rect.x0 / DepthBlockSize; bx <= (rect.x1 - 1) / DepthBlockSize; bx++)
+            t.blockMaxZ[by * t.blocksX + bx] = INFINITY;
+}
+
+static TileRect Intersect(const TileRect& a, int minX, int minY, int maxX, int maxY)
+{
+    return { std::max(a.x0, minX), std::max(a.y0, minY), std::min(a.x1, maxX + 1), std::min(a.y1, maxY + 1) };
+}
+
+void RasterizeTile(const RasterTarget& target, const TileRect& tile, const RasterPrimitive* prims,
+    const RasterTexturing* texturings, const RasterGroup* groups, const uint32_t* ids, size_t count, RasterStats& stats)
+{
+    const TriangleKernel* kernels = GetKernel().kernels[(int)target.depthFormat];
+    TriangleKernel flat = kernels[target.framebuffer ? (int)target.colorFormat : DepthOnlyKernel];
+    TriangleKernel smooth = target.framebuffer ? kernels[SmoothKernels + (int)target.colorFormat] : flat;
+    TriangleKernel textured = target.framebuffer ? kernels[TexturedKernels + (int)target.colorFormat] : flat;
+    const int tileBlocks = 8 * DepthBlockSize;
+    uint64_t& dirty = target.tileDirty[(tile.y0 / tileBlocks) * target.tilesX + tile.x0 / tileBlocks];
+    uint32_t group = 0;
+    bool groupHidden = false;
+
+    // nearest block max in the tile: a triangle nearer than that is visible in
+    // every block, so it skips the per-block test. Block maxima only change when
+    // a group test remeasures them, so this is refreshed after each one.
+    auto nearestMax = [&]() {
+        float m = INFINITY;
+        for (int by = tile.y0 / DepthBlockSize; by <= (tile.y1 - 1) / DepthBlockSize; by++)
+            for (int bx = tile.x0 / DepthBlockSize; bx <= (tile.x1 - 1) / DepthBlockSize; bx++)
+                m = std::min(m, target.blockMaxZ[by * target.blocksX + bx]);
+        return m;
+    };
+    float tileNearest = nearestMax();
+
+    for (size_t i = 0; i < count; i++) {
+        const RasterPrimitive& prim = prims[ids[i]];
+        if (prim.type == PrimitiveType::Line) {
+            if (target.framebuffer) RasterLine(target, tile, prim);
+            continue;
+        }
+
+        // a group is tested once, at its first primitive in this tile; the depth
+        // blocks only get nearer while its primitives draw, so the answer holds
+        if (prim.group != group) {
+            group = prim.group;
+            const RasterGroup& g = groups[group];
+            TileRect r = Intersect(tile, g.minX, g.minY, g.maxX, g.maxY);
+            groupHidden = group != 0 && (r.x0 >= r.x1 || r.y0 >= r.y1 || !AnyBlockVisible(target, tile, dirty, r, g.minZ));
+            if (group != 0) tileNearest = nearestMax();
+        }
+        if (groupHidden) continue;
+
+        TileRect rect = Intersect(tile, prim.minX, prim.minY, prim.maxX, prim.maxY);
+        if (prim.state.depthTest) {
+            float minZ = std::min({ prim.v0.z, prim.v1.z, prim.v2.z });
+            if (!(minZ < tileNearest) && !AnyBlockMaybeVisible(target, rect, minZ)) continue;
+        }
+
+        if (prim.shading == RasterShading::Textured) textured(target, tile, prim, &texturings[prim.color], stats);
+        else (prim.shading == RasterShading::Smooth ? smooth : flat)(target, tile, prim, nullptr, stats);
+        if (prim.state.depthWrite) {
+            dirty |= BlockMask(tile, rect);
+            // untested writes can push depth back, so the stored maxima stop being bounds
+            if (!prim.state.depthTest) UnboundBlocks(target, rect);
+        }
+    }
+}
+
+static int SkyColorAt(const RasterSky& sky, float px, float py)
+{
+    float dx = sky.dir0.x + px * sky.dirDx.x + py * sky.dirDy.x;
+    float dy = sky.dir0.y + px * sky.dirDx.y + py * sky.dirDy.y;
+    float dz = sky.dir0.z + px * sky.dirDx.z + py * sky.dirDy.z;
+    float ax = std::abs(dx), ay = std::abs(dy), az = std::abs(dz);
+    if (az >= ax && az >= ay) return sky.faceColor[dz >= 0 ? 0 : 1];
+    if (ax >= ay) return sky.faceColor[dx < 0 ? 2 : 3];
+    return sky.faceColor[dy >= 0 ? 4 : 5];
+}
+
+template <typename Depth, typename Color>
+static void FillSkyAs(const RasterTarget& target, const TileRect& tile, const RasterSky& sky)
+{
+    // each face covers a convex region of the screen, so when the tile's corner
+    // pixels agree on a face the whole tile is that one color
+    float left = tile.x0 + 0.5f, right = tile.x1 - 0.5f, top = tile.y0 + 0.5f, bottom = tile.y1 - 0.5f;
+    int corner = SkyColorAt(sky, left, top);
+    bool uniform = SkyColorAt(sky, right, top) == corner && SkyColorAt(sky, left, bottom) == corner
+        && SkyColorAt(sky, right, bottom) == corner;
+    corner = Color::Pack(corner);
+
+    for (int y = tile.y0; y < tile.y1; y++) {
+        size_t row = target.address.Row(y);
+        float py = (float)y + 0.5f;
+        int x = tile.x0;
+#ifdef CHOMP_X86
+        // 4 pixels per step; covered groups cost a compare and a movemask
+        const __m128 farKey = _mm_set1_ps(Depth::FarKey);
+        if (uniform) {
+            const __m128i color = Color::Splat4(corner);
+            for (; x + 4 <= tile.x1; x += 4) {
+                size_t i = row + target.address.Column(x);
+                __m128 open = _mm_cmpgt_ps(Depth::KeyFloat4(target.zbuffer, i), farKey);
+                int bits = _mm_movemask_ps(open);
+                if (bits == 0xF) Color::Put4(target.framebuffer, i, color);
+                else if (bits) Color::Fill4(target.framebuffer, i, open, color);
+            }
+        }
+        else {
+            const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 signBit = _mm_set1_ps(-0.0f), zero = _mm_setzero_ps();
+            const __m128 dxX = _mm_set1_ps(sky.dirDx.x), dxY = _mm_set1_ps(sky.dirDx.y), dxZ = _mm_set1_ps(sky.dirDx.z);
+            const __m128 rowX = _mm_set1_ps(sky.dir0.x + py * sky.dirDy.x);
+            const __m128 rowY = _mm_set1_ps(sky.dir0.y + py * sky.dirDy.y);
+            const __m128 rowZ = _mm_set1_ps(sky.dir0.z + py * sky.dirDy.z);
+            __m128i c[6];
+            for (int f = 0; f < 6; f++) c[f] = _mm_set1_epi32(Color::Pack(sky.faceColor[f]));
+            for (; x + 4 <= tile.x1; x += 4) {
+                size_t i = row + target.address.Column(x);
+                __m128 open = _mm_cmpgt_ps(Depth::KeyFloat4(target.zbuffer, i), farKey);
+                if (!_mm_movemask_ps(open)) continue;
+
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+                __m128 dx = _mm_add_ps(rowX, _mm_mul_ps(px, dxX));
+                __m128 dy = _mm_add_ps(rowY, _mm_mul_ps(px, dxY));
+                __m128 dz = _mm_add_ps(rowZ, _mm_mul_ps(px, dxZ));
+                __m128 ax = _mm_andnot_ps(signBit, dx), ay = _mm_andnot_ps(signBit, dy), az = _mm_andnot_ps(signBit, dz);
+
+                __m128i faceZ = Select(_mm_cmpge_ps(dz, zero), c[0], c[1]);
+                __m128i faceX = Select(_mm_cmplt_ps(dx, zero), c[2], c[3]);
+                __m128i faceY = Select(_mm_cmpge_ps(dy, zero), c[4], c[5]);
+                __m128i color = Select(_mm_cmpge_ps(ax, ay), faceX, faceY);
+                color = Select(_mm_and_ps(_mm_cmpge_ps(az, ax), _mm_cmpge_ps(az, ay)), faceZ, color);
+                if (_mm_movemask_ps(open) == 0xF) Color::Store4(target.framebuffer, i, color);
+                else Color::Blend4(target.framebuffer, i, open, color);
+            }
+        }
+#endif
+        for (; x < tile.x1; x++) {
+            size_t i = row + target.address.Column(x);
+            if (Depth::KeyAt(target.zbuffer, i) > Depth::FarKey)
+                Color::Store(target.framebuffer, i, uniform ? corner : Color::Pack(SkyColorAt(sky, (float)x + 0.5f, py)));
+        }
+    }
+}
+
+void FillSkyTile(const RasterTarget& target, const TileRect& tile, const RasterSky& sky)
+{
+    WithFormats(target, [&](auto depth, auto color) {
+        FillSkyAs<decltype(depth), decltype(color)>(target, tile, sky);
+    });
+}
+
+// Rounds exactly like the 4-wide path in ShadowAs, so a pixel's answer does not
+// depend on which of the two it went through
+template <typename Depth>
+static bool InShadow(const RasterShadow& shadow, float bias, float px, float py, float key)
+{
+    const float(*s)[4] = shadow.screenToLight.m;
+    float l[4];
+    for (int r = 0; r < 4; r++)
+        l[r] = (s[r][1] * py + s[r][3]) + (s[r][0] * px + (s[r][2] * Depth::DepthPerKey) * key);
+    float invW = 1.0f / l[3];
+    float lx = l[0] * invW, ly = l[1] * invW, lz = l[2] * invW;
+    if (!(lx >= 0 && ly >= 0 && lx < (float)shadow.size && ly < (float)shadow.size)) return false;
+    return lz > shadow.depth[(int)ly * shadow.size + (int)lx] + bias;
+}
+
+template <typename Depth, typename Color>
+static void ShadowAs(const RasterTarget& target, const TileRect& tile, const RasterShadow& shadow)
+{
+    const float(*s)[4] = shadow.screenToLight.m;
+    // a quantized depth buffer moves each point by up to a step: widen the bias by
+    // what that step is in the light's depth
+    const float bias = shadow.bias + std::abs(s[2][2]) * Depth::KeyStep * Depth::DepthPerKey;
+    for (int y = tile.y0; y < tile.y1; y++) {
+        size_t row = target.address.Row(y);
+        float py = (float)y + 0.5f;
+        int x = tile.x0;
+#ifdef CHOMP_X86
+        // the projection is 4 pixels per step; the map reads are scalar, there being no
+        // gather before AVX2
+        // depth enters as a key, so the depth column absorbs DepthPerKey
+        const __m128 farKey = _mm_set1_ps(Depth::FarKey), zero = _mm_setzero_ps(), size = _mm_set1_ps((float)shadow.size);
+        const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 rowBase[4], colStep[4], depthStep[4];
+        for (int r = 0; r < 4; r++) {
+            rowBase[r] = _mm_set1_ps(s[r][1] * py + s[r][3]);
+            colStep[r] = _mm_set1_ps(s[r][0]);
+            depthStep[r] = _mm_set1_ps(s[r][2] * Depth::DepthPerKey);
+        }
+        for (; x + 4 <= tile.x1; x += 4) {
+            size_t i = row + target.address.Column(x);
+            __m128 z = Depth::KeyFloat4(target.zbuffer, i);
+            __m128 covered = _mm_cmple_ps(z, farKey);
+            if (!_mm_movemask_ps(covered)) continue;
+
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+            __m128 l[4];
+            for (int r = 0; r < 4; r++)
+                l[r] = _mm_add_ps(rowBase[r], _mm_add_ps(_mm_mul_ps(colStep[r], px), _mm_mul_ps(depthStep[r], z)));
+            __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), l[3]);
+            __m128 lx = _mm_mul_ps(l[0], invW), ly = _mm_mul_ps(l[1], invW), lz = _mm_mul_ps(l[2], invW);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(lx, zero), _mm_cmpge_ps(ly, zero)),
+                _mm_and_ps(_mm_cmplt_ps(lx, size), _mm_cmplt_ps(ly, size)));
+            int test = _mm_movemask_ps(_mm_and_ps(covered, inside));
+            if (!test) continue;
+
+            alignas(16) int tx[4], ty[4];
+            alignas(16) float lightZ[4];
+            _mm_store_si128((__m128i*)tx, _mm_cvttps_epi32(lx));
+            _mm_store_si128((__m128i*)ty, _mm_cvttps_epi32(ly));
+            _mm_store_ps(lightZ, lz);
+            int shadowed = 0;
+            for (int k = 0; k < 4; k++) {
+                if (!(test & (1 << k))) continue;
+                if (lightZ[k] > shadow.depth[ty[k] * shadow.size + tx[k]] + bias) shadowed |= 1 << k;
+            }
+            if (!shadowed) continue;
+
+            __m128i m = _mm_setr_epi32(shadowed & 1 ? -1 : 0, shadowed & 2 ? -1 : 0, shadowed & 4 ? -1 : 0, shadowed & 8 ? -1 : 0);
+            Color::Blend4(target.framebuffer, i, _mm_castsi128_ps(m), Color::Darken4(Color::Load4(target.framebuffer, i)));
+        }
+#endif
+        for (; x < tile.x1; x++) {
+            size_t i = row + target.address.Column(x);
+            float key = Depth::KeyAt(target.zbuffer, i);
+            if (key <= Depth::FarKey && InShadow<Depth>(shadow, bias, (float)x + 0.5f, py, key))
+                Color::Store(target.framebuffer, i, Color::Darken(Color::Load(target.framebuffer, i)));
+        }
+    }
+}
+
+void ShadowTile(const RasterTarget& target, const TileRect& tile, const RasterShadow& shadow)
+{
+    WithFormats(target, [&](auto depth, auto color) {
+        ShadowAs<decltype(depth), decltype(color)>(target, tile, shadow);
+    });
+}
+
+// a depth step to a neighbour is a break when it is this many times steeper than
+// the surface on either side of it (the steps just before and just after), plus
+// float noise. Creases between flat faces stay under it: their step is never
+// steeper than the faces themselves.
+static const float OutlineSlope = 2.0f;
+static const float OutlineEpsilon = 1e-6f;
+
+template <typename Depth>
+static bool IsOutline(const RasterTarget& t, const RasterOutline& outline, float eps, int x, int y)
+{
+    const PixelAddress& a = t.address;
+    const int w = t.width, h = t.height;
+    const size_t i = a(x, y);
+    float z = Depth::KeyAt(t.zbuffer, i);
+    if (!(z <= Depth::FarKey)) return false;
+    // left, right, up, down, each opposite the next, one and two pixels away; off
+    // screen reads as the nearest pixel on it
+    size_t n1[4] = { a(std::max(x - 1, 0), y), a(std::min(x + 1, w - 1), y),
+        a(x, std::max(y - 1, 0)), a(x, std::min(y + 1, h - 1)) };
+    size_t n2[4] = { a(std::max(x - 2, 0), y), a(std::min(x + 2, w - 1), y),
+        a(x, std::max(y - 2, 0)), a(x, std::min(y + 2, h - 1)) };
+    for (int k = 0; k < 4; k++) {
+        float zn = Depth::KeyAt(t.zbuffer, n1[k]);
+        if (!(zn <= Depth::FarKey)) return true;
+        float before = std::abs(z - Depth::KeyAt(t.zbuffer, n1[k ^ 1]));
+        float after = std::abs(zn - Depth::KeyAt(t.zbuffer, n2[k]));
+        if (zn - z > OutlineSlope * std::max(before, after) + eps) return true;
+        if (outline.objectIds && t.objectIds[n1[k]] != t.objectIds[i] && zn > z) return true;
+    }
+    return false;
+}
+
+#ifdef CHOMP_X86
+// The values one and two pixels left and right of a group of 4, from it and the
+// groups of 4 either side: x - 1, x + 1, x - 2, x + 2, like IsOutline's neighbours
+static inline void Shifted4(__m128 left, __m128 self, __m128 right, __m128 out[4])
+{
+    out[2] = _mm_shuffle_ps(left, self, _MM_SHUFFLE(1, 0, 3, 2));
+    out[3] = _mm_shuffle_ps(self, right, _MM_SHUFFLE(1, 0, 3, 2));
+    out[0] = _mm_shuffle_ps(out[2], self, _MM_SHUFFLE(2, 1, 2, 1));
+    out[1] = _mm_shuffle_ps(self, out[3], _MM_SHUFFLE(2, 1, 2, 1));
+}
+#endif
+
+template <typename Depth, typename Color>
+static void OutlineRowsAs(const RasterTarget& target, int y0, int y1, const RasterOutline& outline)
+{
+    const PixelAddress& a = target.address;
+    const int w = target.width, h = target.height;
+    const int color = Color::Pack(outline.color);
+    // the test runs on keys; each of its three differences can be off by a key step
+    const float eps = OutlineEpsilon / Depth::DepthPerKey + 3.0f * Depth::KeyStep;
+    for (int y = y0; y < y1; y++) {
+        size_t row = a.Row(y);
+        int x = 0;
+#ifdef CHOMP_X86
+        // 4 pixels per step, the left and right neighbours shuffled out of the groups
+        // either side, so every load is a group of 4 within a run of 8 contiguous
+        // pixels; the first four columns and the last four to eight go to the scalar path
+        for (; x < std::min(4, w); x++)
+            if (IsOutline<Depth>(target, outline, eps, x, y)) Color::Store(target.framebuffer, row + a.Column(x), color);
+
+        const void* zb = target.zbuffer;
+        const size_t rows[4] = { a.Row(std::max(y - 2, 0)), a.Row(std::max(y - 1, 0)),
+            a.Row(std::min(y + 1, h - 1)), a.Row(std::min(y + 2, h - 1)) };
+        const uint32_t* ids = outline.objectIds ? target.objectIds : nullptr;
+        const __m128 farKey = _mm_set1_ps(Depth::FarKey), slope = _mm_set1_ps(OutlineSlope), epsilon = _mm_set1_ps(eps);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        const __m128i outlineColor = Color::Splat4(color);
+        for (; x + 8 <= w; x += 4) {
+            size_t c = a.Column(x), left = a.Column(x - 4), right = a.Column(x + 4);
+            __m128 z = Depth::KeyFloat4(zb, row + c);
+            __m128 covered = _mm_cmple_ps(z, farKey);
+            if (!_mm_movemask_ps(covered)) continue;
+
+            __m128 across[4];
+            Shifted4(Depth::KeyFloat4(zb, row + left), z, Depth::KeyFloat4(zb, row + right), across);
+            __m128 n1[4] = { across[0], across[1], Depth::KeyFloat4(zb, rows[1] + c), Depth::KeyFloat4(zb, rows[2] + c) };
+            __m128 n2[4] = { across[2], across[3], Depth::KeyFloat4(zb, rows[0] + c), Depth::KeyFloat4(zb, rows[3] + c) };
+            __m128 edge = _mm_setzero_ps();
+            for (int k = 0; k < 4; k++) {
+                __m128 before = _mm_andnot_ps(signBit, _mm_sub_ps(z, n1[k ^ 1]));
+                __m128 after = _mm_andnot_ps(signBit, _mm_sub_ps(n1[k], n2[k]));
+                __m128 limit = _mm_add_ps(_mm_mul_ps(slope, _mm_max_ps(before, after)), epsilon);
+                edge = _mm_or_ps(edge, _mm_cmpgt_ps(n1[k], farKey));
+                edge = _mm_or_ps(edge, _mm_cmpgt_ps(_mm_sub_ps(n1[k], z), limit));
+            }
+            if (ids) {
+                __m128i self = _mm_loadu_si128((const __m128i*)(ids + row + c));
+                __m128 idsAcross[4];
+                Shifted4(_mm_loadu_ps((const float*)(ids + row + left)), _mm_castsi128_ps(self),
+                    _mm_loadu_ps((const float*)(ids + row + right)), idsAcross);
+                __m128i others[4] = { _mm_castps_si128(idsAcross[0]), _mm_castps_si128(idsAcross[1]),
+                    _mm_loadu_si128((const __m128i*)(ids + rows[1] + c)), _mm_loadu_si128((const __m128i*)(ids + rows[2] + c)) };
+                for (int k = 0; k < 4; k++) {
+                    __m128 differs = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(others[k], self)), _mm_cmpgt_ps(n1[k], z));
+                    edge = _mm_or_ps(edge, differs);
+                }
+            }
+            __m128 m = _mm_and_ps(edge, covered);
+            if (!_mm_movemask_ps(m)) continue;
+            Color::Fill4(target.framebuffer, row + c, m, outlineColor);
+        }
+#endif
+        for (; x < w; x++)
+            if (IsOutline<Depth>(target, outline, eps, x, y)) Color::Store(target.framebuffer, row + a.Column(x), color);
+    }
+}
+
+void OutlineRows(const RasterTarget& target, int y0, int y1, const RasterOutline& outline)
+{
+    WithFormats(target, [&](auto depth, auto color) {
+        OutlineRowsAs<decltype(depth), decltype(color)>(target, y0, y1, outline);
+    });
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include "../objects/Types.h"
+#include "TargetFormat.h"
+#include <cstdint>
+#include <cstddef>
+
+struct RasterState {
+    bool depthTest = true;
+    bool depthWrite = true;
+};
+
+enum class PrimitiveType : uint8_t {
+    Triangle,
+    Line
+};
+
+// Object id of pixels and primitives that belong to no submitted batch
+static const uint32_t NoObject = 0;
+
+// Mip-mapped texture as the kernels sample it (Texture builds one). Each level is a
+// power of two on each side and stored in TextureTileSize squares, row by row, with
+// the texels of a square in Morton (Z) order: a bilinear fetch's 2x2 texels mostly
+// share a cache line whichever way the surface runs across the screen.
+static const int TextureTileSize = 8;
+static const int MaxTextureLevels = 16;
+
+struct RasterTextureLevel {
+    const uint32_t* texels; // PackColor values
+    int width, height;
+    int tileRowShift;       // log2 of the squares per row
+};
+
+struct RasterTexture {
+    RasterTextureLevel levels[MaxTextureLevels]; // finest first
+    int levelCount;
+};
+
+enum class RasterShading : uint8_t {
+    Flat,
+    Smooth,  // Gouraud: color scaled at each pixel by the interpolated shade
+    Textured // smooth, with texels in place of the color
+};
+
+// Screen-space primitive, set up once at submit and shared by every tile it touches.
+// Two cache lines: what only textured triangles need lives in a RasterTexturing.
+struct RasterPrimitive {
+    Vec3 v0, v1, v2;            // a line only uses v0 and v1
+    int minX, minY, maxX, maxY; // inclusive pixel bounds, clamped to the target
+    int color;                  // PackColor; for Textured, the index of its RasterTexturing
+                                // (a union would stop the compiler building one in registers)
+    PrimitiveType type;
+    RasterState state;
+    RasterShading shading;
+    uint32_t group;             // RasterGroup it was submitted with, 0 for none
+    uint32_t object;            // id of the batch it came from, NoObject for loose primitives
+
+    // Triangle setup, filled in by SetupTriangle
+    float edgeA[3], edgeB[3], edgeC[3]; // edge i at pixel center p: A*p.x + B*p.y + C, inside when >= 0
+    float zdx, zdy, z0;                 // depth plane: z = zdx*p.x + zdy*p.y + z0
+    // unless flat: the shades in [0, 1] at v0, v1, v2, which SetupTriangle
+    // replaces by their plane, laid out like the depth one
+    float shade[3];
+};
+static_assert(sizeof(RasterPrimitive) == 128, "primitives are binned and read per tile; keep them two cache lines");
+
+// Texture of a Textured primitive, sampled with repeat and scaled by its shade.
+// tex holds u/w, v/w and 1/w at v0, v1, v2 (w being clip-space w), which
+// SetupTriangle replaces by their planes; u and v are then divided per pixel,
+// which keeps them perspective-correct.
+struct RasterTexturing {
+    const RasterTexture* texture;
+    float tex[3][3];
+    int mip; // level sampled, picked by SetupTriangle
+};
+
+// Screen bounds and nearest depth of a batch of primitives (one mesh draw), so a
+// whole object hidden in a tile is skipped with one test
+struct RasterGroup {
+    int minX, minY, maxX, maxY; // inclusive, clamped to the target
+    float minZ;
+};
+
+// Hierarchical depth: one conservative max depth per DepthBlockSize square of the
+// zbuffer. A raster tile is 8x8 blocks, so the blocks written since they were last
+// measured fit in one 64-bit mask per tile.
+static const int DepthBlockSize = 8;
+
+struct RasterTarget {
+    void* framebuffer;   // colorFormat pixels, null for a depth-only pass
+    void* zbuffer;       // depthFormat values
+    uint32_t* objectIds; // object that last wrote each pixel's depth (NoObject for none), or null
+    int width, height;
+    ColorFormat colorFormat;
+    DepthFormat depthFormat;
+    PixelAddress address; // of a pixel in all three planes, which share a layout
+
+    float* blockMaxZ;    // >= every depth in the block, exact unless its dirty bit is set
+    int blocksX;
+    uint64_t* tileDirty; // per tile, bit (by * 8 + bx) for its blocks
+    int tilesX;
+};
+
+// Triangle pixels that reached the depth test, and those that passed it (or were
+// drawn untested) and were written
+struct RasterStats {
+    uint64_t pixelsTested = 0;
+    uint64_t pixelsWritten = 0;
+};
+
+// Half-open pixel rectangle owned by a single worker
+struct TileRect {
+    int x0, y0, x1, y1;
+};
+
+// Background cube behind everything drawn: a pixel's view direction (sky space,
+// not normalized) is dir0 + x * dirDx + y * dirDy at its center, and it takes the
+// color of the cube face that direction exits through
+struct RasterSky {
+    Vec3 dir0, dirDx, dirDy;
+    int faceColor[6]; // +z, -z, -x, +x, +y, -y
+};
+
+// Shadow map lookup for the pixels of the main pass: screenToLight takes a pixel
+// (x, y, depth, 1) to the map's homogeneous pixel coordinates and depth
+struct RasterShadow {
+    Mat4 screenToLight;
+    const float* depth; // size * size light-space depths, Float32
+    int size;
+    float bias;         // light-space depth a point may sit behind the map and still be lit
+};
+
+// Screen-space outlines: a covered pixel becomes color when a neighbour is background,
+// lies well behind it (a depth jump steeper than the surface's own slope), or, with
+// object ids, belongs to another object behind it
+struct RasterOutline {
+    int color;
+    bool objectIds;
+};
+
+inline int PackColor(Color c) {
+    return (c.r << 16) | (c.g << 8) | c.b;
+}
+
+// Depth offset for a pass (shadow maps): each triangle's depth plane is pushed
+// back by constant plus slope times its depth change across one pixel diagonally,
+// the slope part capped at maxSlope
+struct RasterDepthBias {
+    float constant = 0, slope = 0, maxSlope = 0;
+};
+
+// Edge, depth, shade and texture plane equations for a triangle with positive
+// area. Textured triangles sample one mip level throughout, the one whose texels
+// come nearest to one per pixel over the whole triangle.
+void SetupTriangle(RasterPrimitive& prim, RasterTexturing* texturings, const RasterDepthBias& bias = {});
+
+// Rasterizes prims[ids[0..count)] in order, touching only pixels inside the tile;
+// texturings holds the RasterTexturing the Textured ones index.
+// Depth-tested triangles and groups whose nearest depth is behind every depth
+// block they overlap are dropped before any per-pixel work. Pixel counts are added to stats.
+void RasterizeTile(const RasterTarget& target, const TileRect& tile, const RasterPrimitive* prims,
+    const RasterTexturing* texturings, const RasterGroup* groups, const uint32_t* ids, size_t count, RasterStats& stats);
+
+// Colors the tile's pixels whose depth is still beyond the far plane (no depth
+// write reached them) from the sky; depth is left as it is
+void FillSkyTile(const RasterTarget& target, const TileRect& tile, const RasterSky& sky);
+
+// Halves the color of the tile's covered pixels that lie behind the shadow map;
+// points outside the map are lit
+void ShadowTile(const RasterTarget& target, const TileRect& tile, const RasterShadow& shadow);
+
+// Outlines rows [y0, y1) of the whole target, reading depth (and ids) one row
+// above and below; rows can run in parallel since only color is written
+void OutlineRows(const RasterTarget& target, int y0, int y1, const RasterOutline& outline);
+
+// Instruction set picked for the triangle kernel on this CPU ("avx2", "sse2" or "scalar")
+const char* GetRasterIsaName();
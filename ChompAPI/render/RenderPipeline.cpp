@@ -0,0 +1,703 @@
+#include "RenderPipeline.h"
+#include "ShadowMap.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+// primitives binned by one worker before splitting into another chunk
+static const size_t MinChunkSize = 1024;
+// vertices transformed by one worker before splitting into another chunk
+static const size_t MinVertexChunk = 16384;
+// rows filtered by one outline job
+static const int OutlineBand = 16;
+
+// vertex outcodes: which frustum planes a vertex is outside of. A vertex behind
+// the near plane gets ClipNear alone, since its screen position is meaningless.
+static const uint8_t ClipLeft = 1, ClipRight = 2, ClipTop = 4, ClipBottom = 8, ClipNear = 16, ClipFar = 32;
+
+static unsigned ResolveThreadCount(unsigned threadCount)
+{
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    return std::max(threadCount, 1u);
+}
+
+RenderPipeline::RenderPipeline(unsigned threadCount, bool pipelined)
+    : pool(pipelined ? (ResolveThreadCount(threadCount) + 3) / 4 : threadCount)
+{
+    if (!pipelined) return;
+    unsigned total = ResolveThreadCount(threadCount);
+    rasterPool = std::make_unique<ThreadPool>(std::max(total - pool.GetThreadCount(), 1u));
+    rasterThread = std::thread([this]() { RasterLoop(); });
+}
+
+RenderPipeline::~RenderPipeline()
+{
+    if (!rasterThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(rasterMutex);
+        stopping = true;
+    }
+    rasterChanged.notify_all();
+    rasterThread.join(); // after drawing whatever is still queued
+}
+
+void RenderPipeline::Begin(int* framebuffer, float* zbuffer, int width, int height)
+{
+    Begin({ framebuffer, zbuffer, width, height, ColorFormat::XRGB8888, DepthFormat::Float32 });
+}
+
+void RenderPipeline::Begin(const RenderTarget& frame)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Clear);
+    const int width = frame.width, height = frame.height;
+    int blocksX = (width + DepthBlockSize - 1) / DepthBlockSize;
+    int blocksY = (height + DepthBlockSize - 1) / DepthBlockSize;
+    // the caller has just cleared (or otherwise filled) the zbuffer: every block
+    // starts unbounded and is measured the first time an object is tested against it
+    tilesX = (width + TileSize - 1) / TileSize;
+    tilesY = (height + TileSize - 1) / TileSize;
+    // pipelined, the pass before last may still be drawing with the state this one takes
+    currentFrame ^= 1;
+    for (const Batch& b : batches)
+        if (b.uncounted && b.frame == currentFrame) WaitForRaster();
+    FrameState& state = frames[currentFrame];
+    state.blockMaxZ.assign((size_t)blocksX * blocksY, INFINITY);
+    state.tileDirty.assign((size_t)tilesX * tilesY, ~0ull);
+    state.rasterStats = RasterStats();
+
+    target = { frame.color, frame.depth, nullptr, width, height, frame.colorFormat, frame.depthFormat,
+        AddressOf(width, frame.layout), state.blockMaxZ.data(), blocksX, state.tileDirty.data(), tilesX };
+    layout = frame.layout;
+    frameCamera = camera;
+    viewProj = camera.ViewProjection(width, height);
+    Mat4 view = camera.ViewMatrix();
+    for (int k = 0; k < 4; k++) viewZ[k] = view.m[2][k];
+    stats = CullStats();
+    profiledStats = CullStats();
+#ifdef CHOMP_PROFILE
+    Profiler::Get().AddTarget((uint64_t)width * height);
+#endif
+
+    // clip space keeps 0 <= x <= width * w, 0 <= y <= height * w and 0 <= z <= w;
+    // each bound is a combination of viewProj rows
+    const float* r[4] = { viewProj.m[0], viewProj.m[1], viewProj.m[2], viewProj.m[3] };
+    float extent[2] = { (float)width, (float)height };
+    for (int k = 0; k < 4; k++) {
+        for (int axis = 0; axis < 2; axis++) {
+            frustum[axis * 2][k] = r[axis][k];
+            frustum[axis * 2 + 1][k] = extent[axis] * r[3][k] - r[axis][k];
+        }
+        frustum[4][k] = r[2][k];
+        frustum[5][k] = r[3][k] - r[2][k];
+    }
+    for (float* plane : frustum) {
+        float len = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (len > 0)
+            for (int k = 0; k < 4; k++) plane[k] /= len;
+    }
+    prims.clear();
+    texturings.clear();
+    groups.assign(1, RasterGroup{});
+    hasSky = false;
+    hasShadow = false;
+    hasOutline = false;
+    depthBias = {};
+    objectCount = 0;
+}
+
+const TransformedVertices& RenderPipeline::TransformVertices(const Transform& t, const VertexBuffer& vertices)
+{
+    return TransformVertices(Mat4::FromTransform(t), vertices);
+}
+
+const TransformedVertices& RenderPipeline::TransformVertices(const Mat4& model, const VertexBuffer& vertices)
+{
+    return TransformVertices(model, vertices.x.data(), vertices.y.data(), vertices.z.data(), vertices.Size());
+}
+
+const TransformedVertices& RenderPipeline::TransformVertices(const Mat4& model, const float* x, const float* y, const float* z, size_t count)
+{
+    return TransformInstances(&model, 1, x, y, z, count);
+}
+
+const TransformedVertices& RenderPipeline::TransformInstances(const Mat4* models, size_t instanceCount, const float* x, const float* y, const float* z, size_t count)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Transform);
+    const size_t total = instanceCount * count;
+    transformed.x.resize(total);
+    transformed.y.resize(total);
+    transformed.z.resize(total);
+    transformed.w.resize(total);
+    transformed.mvp.resize(instanceCount);
+    for (size_t i = 0; i < instanceCount; i++) transformed.mvp[i] = viewProj * models[i];
+    transformed.srcX = x; transformed.srcY = y; transformed.srcZ = z;
+    transformed.sourceCount = count;
+    if (total == 0) return transformed;
+
+    // chunks split the flat output range, so one large instance and many small
+    // ones spread across workers alike; each piece is a SIMD pass over source vertices
+    int chunks = (int)std::min<size_t>(pool.GetThreadCount(), (total + MinVertexChunk - 1) / MinVertexChunk);
+    chunks = std::max(chunks, 1);
+    pool.ParallelFor(chunks, [&](int c) {
+        size_t begin = total * c / chunks;
+        size_t end = total * (c + 1) / chunks;
+        while (begin < end) {
+            size_t instance = begin / count, first = begin % count;
+            size_t n = std::min(count - first, end - begin);
+            TransformVertexRange(transformed.mvp[instance], x + first, y + first, z + first, n,
+                transformed.x.data() + begin, transformed.y.data() + begin, transformed.z.data() + begin, transformed.w.data() + begin);
+            begin += n;
+        }
+        });
+    return transformed;
+}
+
+bool RenderPipeline::IsVisible(const Mat4& model, const BoundingSphere& bounds)
+{
+    stats.objectsTested++;
+    Vec3 c = model.TransformPoint(bounds.center);
+    // the largest axis scale of the model matrix bounds how far the radius can stretch
+    float scale2 = 0;
+    for (int j = 0; j < 3; j++)
+        scale2 = std::max(scale2, model.m[0][j] * model.m[0][j] + model.m[1][j] * model.m[1][j] + model.m[2][j] * model.m[2][j]);
+    float radius = bounds.radius * std::sqrt(scale2);
+
+    for (const float* plane : frustum) {
+        if (plane[0] * c.x + plane[1] * c.y + plane[2] * c.z + plane[3] < -radius) {
+            stats.objectsCulled++;
+            return false;
+        }
+    }
+    return true;
+}
+
+float RenderPipeline::PixelsPerUnit(const Vec3& center, float radius) const
+{
+    if (frameCamera.projection == ProjectionType::Orthographic) return frameCamera.pixelsPerUnit;
+    // perspective w is view depth
+    const float* r = viewProj.m[3];
+    float depth = r[0] * center.x + r[1] * center.y + r[2] * center.z + r[3] - radius;
+    if (!(depth > frameCamera.nearZ)) return INFINITY;
+    float focal = target.height / 2.0f / std::tan(frameCamera.fovY * 0.5f);
+    return focal / depth;
+}
+
+bool RenderPipeline::IsBoxVisible(const Vec3& lo, const Vec3& hi, uint8_t& planes) const
+{
+    for (int i = 0; i < 6; i++) {
+        if (!(planes & (1 << i))) continue;
+        const float* p = frustum[i];
+        // signed distances of the box corners furthest along and against the normal
+        float maxDist = p[0] * (p[0] > 0 ? hi.x : lo.x) + p[1] * (p[1] > 0 ? hi.y : lo.y) + p[2] * (p[2] > 0 ? hi.z : lo.z) + p[3];
+        if (maxDist < 0) return false;
+        float minDist = p[0] * (p[0] > 0 ? lo.x : hi.x) + p[1] * (p[1] > 0 ? lo.y : hi.y) + p[2] * (p[2] > 0 ? lo.z : hi.z) + p[3];
+        if (minDist >= 0) planes &= ~(1 << i);
+    }
+    return true;
+}
+
+void RenderPipeline::SubmitTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color, RasterState state)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Cull);
+    stats.triangles++;
+    AddTriangle(v0, v1, v2, color, state);
+}
+
+// Screen-space triangle after the frustum tests: counts why it is dropped, if it is
+void RenderPipeline::AddTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color, RasterState state)
+{
+    float area = (v2.x - v0.x) * (v1.y - v0.y) - (v2.y - v0.y) * (v1.x - v0.x);
+    if (area < 0) stats.backfacing++;
+    else if (!(area > 0)) stats.degenerate++;
+    else if (EmitTriangle(v0, v1, v2, color, state)) stats.rasterized++;
+    else stats.outside++;
+}
+
+bool RenderPipeline::EmitTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color, RasterState state)
+{
+    // only counter-clockwise (positive edge area) triangles cover any pixel
+    float area = (v2.x - v0.x) * (v1.y - v0.y) - (v2.y - v0.y) * (v1.x - v0.x);
+    if (!(area > 0)) return false;
+
+    // clamp in float space first so far-off vertices never overflow the int conversion
+    float minX = std::min({ v0.x, v1.x, v2.x }), maxX = std::max({ v0.x, v1.x, v2.x });
+    float minY = std::min({ v0.y, v1.y, v2.y }), maxY = std::max({ v0.y, v1.y, v2.y });
+    if (maxX < 0 || maxY < 0 || minX > (float)target.width || minY > (float)target.height) return false;
+
+    RasterPrimitive p;
+    p.minX = std::max(0, (int)std::floor(std::max(minX, 0.0f)));
+    p.maxX = std::min(target.width - 1, (int)std::ceil(std::min(maxX, (float)target.width)));
+    p.minY = std::max(0, (int)std::floor(std::max(minY, 0.0f)));
+    p.maxY = std::min(target.height - 1, (int)std::ceil(std::min(maxY, (float)target.height)));
+    if (p.minX > p.maxX || p.minY > p.maxY) return false;
+
+    p.v0 = v0; p.v1 = v1; p.v2 = v2;
+    p.color = PackColor(color);
+    p.type = PrimitiveType::Triangle;
+    p.state = state;
+    p.shading = RasterShading::Flat;
+    p.group = currentGroup;
+    p.object = currentObject;
+    prims.push_back(p);
+    return true;
+}
+
+void RenderPipeline::SetShades(size_t first, float s0, float s1, float s2)
+{
+    for (size_t i = first; i < prims.size(); i++) {
+        RasterPrimitive& p = prims[i];
+        p.shading = RasterShading::Smooth;
+        p.shade[0] = s0; p.shade[1] = s1; p.shade[2] = s2;
+    }
+}
+
+void RenderPipeline::SetAttributes(size_t emitted, const VertexAttributes& attributes, const TransformedVertices& tv, size_t first, const uint32_t* tri)
+{
+    Corner corners[3];
+    for (int k = 0; k < 3; k++) {
+        size_t i = first + tri[k];
+        corners[k].shade = attributes.shade ? attributes.shade[i] : 1.0f;
+        corners[k].u = attributes.texU ? attributes.texU[tri[k]] : 0.0f;
+        corners[k].v = attributes.texV ? attributes.texV[tri[k]] : 0.0f;
+        corners[k].invW = 1.0f / tv.w[i];
+    }
+    SetAttributes(emitted, attributes, corners);
+}
+
+void RenderPipeline::SetAttributes(size_t first, const VertexAttributes& attributes, const Corner corners[3])
+{
+    for (size_t i = first; i < prims.size(); i++) {
+        RasterPrimitive& p = prims[i];
+        p.shading = RasterShading::Smooth; // textured triangles without shades get a flat 1
+        for (int k = 0; k < 3; k++) p.shade[k] = corners[k].shade;
+        if (!attributes.texture) continue;
+        p.shading = RasterShading::Textured;
+        p.color = (int)texturings.size();
+        RasterTexturing& t = texturings.emplace_back();
+        t.texture = attributes.texture;
+        for (int k = 0; k < 3; k++) {
+            const Corner& c = corners[k];
+            t.tex[0][k] = c.u * c.invW;
+            t.tex[1][k] = c.v * c.invW;
+            t.tex[2][k] = c.invW;
+        }
+    }
+}
+
+// Outcodes vertices [first, first + n) of tv and, for depth-tested batches, opens
+// a group over their screen bounds. Returns the bits all vertices share: non-zero means the
+// whole batch is outside one plane. No group if any vertex is behind the near
+// plane, since clipping will put new vertices where the projection says nothing.
+uint8_t RenderPipeline::BeginBatch(const TransformedVertices& tv, size_t first, size_t n, RasterState state)
+{
+    if (outcodes.size() < first + n) outcodes.resize(first + n);
+    const float width = (float)target.width, height = (float)target.height;
+    float minX = INFINITY, minY = INFINITY, minZ = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    uint8_t any = 0, all = 0xFF;
+    for (size_t i = first; i < first + n; i++) {
+        float x = tv.x[i], y = tv.y[i], z = tv.z[i];
+        uint8_t code;
+        // clip-space z is z * w; it is NaN for w == 0, which also lands here
+        if (!(z * tv.w[i] >= 0)) code = ClipNear;
+        else {
+            code = (x < 0 ? ClipLeft : 0) | (x > width ? ClipRight : 0) | (y < 0 ? ClipTop : 0)
+                | (y > height ? ClipBottom : 0) | (z > 1 ? ClipFar : 0);
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            minZ = std::min(minZ, z);
+        }
+        outcodes[i] = code;
+        any |= code;
+        all &= code;
+    }
+
+    currentGroup = 0;
+    if (!state.depthTest || n == 0 || all || (any & ClipNear)) return n == 0 ? 0 : all;
+
+    RasterGroup g;
+    g.minX = std::max(0, (int)std::floor(std::max(minX, 0.0f)));
+    g.maxX = std::min(target.width - 1, (int)std::ceil(std::min(maxX, width)));
+    g.minY = std::max(0, (int)std::floor(std::max(minY, 0.0f)));
+    g.maxY = std::min(target.height - 1, (int)std::ceil(std::min(maxY, height)));
+    g.minZ = minZ;
+    groups.push_back(g);
+    currentGroup = (uint32_t)groups.size() - 1;
+    return 0;
+}
+
+template <typename ColorOf>
+void RenderPipeline::SubmitBatch(const TransformedVertices& tv, size_t first, size_t vertexCount,
+    const uint32_t* indices, size_t indexCount, ColorOf colorOf, const VertexAttributes* attributes, RasterState state)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Cull);
+    const size_t triCount = indexCount / 3;
+    stats.triangles += triCount;
+    if (BeginBatch(tv, first, vertexCount, state)) {
+        stats.outside += triCount;
+        return;
+    }
+    currentObject = ++objectCount;
+
+    // Gouraud alone is most batches with attributes, and takes a shorter path
+    const float* shades = attributes && attributes->shade && !attributes->texture ? attributes->shade + first : nullptr;
+    const uint8_t* codes = outcodes.data() + first;
+    for (size_t t = 0; t < triCount; t++) {
+        const uint32_t* tri = indices + t * 3;
+        uint8_t c0 = codes[tri[0]], c1 = codes[tri[1]], c2 = codes[tri[2]];
+        if (c0 & c1 & c2) stats.outside++;
+        else if ((c0 | c1 | c2) & ClipNear) SubmitNearClipped(tv, first, tri, colorOf(t), attributes, state);
+        else {
+            size_t emitted = prims.size();
+            AddTriangle(tv.Screen(first + tri[0]), tv.Screen(first + tri[1]), tv.Screen(first + tri[2]), colorOf(t), state);
+            if (shades) SetShades(emitted, shades[tri[0]], shades[tri[1]], shades[tri[2]]);
+            else if (attributes) SetAttributes(emitted, *attributes, tv, first, tri);
+        }
+    }
+    currentGroup = 0;
+    currentObject = NoObject;
+}
+
+// Sutherland-Hodgman against clip-space z >= 0 (the near plane for both
+// projections), on positions rebuilt from the source vertices, then a fan. Shades
+// are interpolated along the clipped edges like the positions.
+void RenderPipeline::SubmitNearClipped(const TransformedVertices& tv, size_t first, const uint32_t* tri, Color color, const VertexAttributes* attributes, RasterState state)
+{
+    struct ClipVertex { float x, y, z, w, s, u, v; };
+    const VertexAttributes none;
+    const VertexAttributes& a = attributes ? *attributes : none;
+    ClipVertex in[3], out[4];
+    for (int k = 0; k < 3; k++) {
+        size_t i = first + tri[k];
+        const Mat4& m = tv.mvp[i / tv.sourceCount];
+        size_t j = i % tv.sourceCount;
+        float x = tv.srcX[j], y = tv.srcY[j], z = tv.srcZ[j];
+        in[k] = { m.m[0][0] * x + m.m[0][1] * y + m.m[0][2] * z + m.m[0][3],
+                  m.m[1][0] * x + m.m[1][1] * y + m.m[1][2] * z + m.m[1][3],
+                  m.m[2][0] * x + m.m[2][1] * y + m.m[2][2] * z + m.m[2][3],
+                  m.m[3][0] * x + m.m[3][1] * y + m.m[3][2] * z + m.m[3][3],
+                  a.shade ? a.shade[i] : 1.0f, a.texU ? a.texU[j] : 0.0f, a.texV ? a.texV[j] : 0.0f };
+    }
+
+    int count = 0;
+    for (int k = 0; k < 3; k++) {
+        const ClipVertex& a = in[k];
+        const ClipVertex& b = in[(k + 1) % 3];
+        if (a.z >= 0) out[count++] = a;
+        if ((a.z >= 0) != (b.z >= 0)) {
+            float s = a.z / (a.z - b.z);
+            out[count++] = { a.x + (b.x - a.x) * s, a.y + (b.y - a.y) * s, 0.0f, a.w + (b.w - a.w) * s,
+                             a.s + (b.s - a.s) * s, a.u + (b.u - a.u) * s, a.v + (b.v - a.v) * s };
+        }
+    }
+    stats.nearClipped++;
+
+    Vec3 screen[4];
+    for (int k = 0; k < count; k++) {
+        if (!(out[k].w > 0)) { // only a perspective camera with nearZ <= 0 gets here
+            stats.degenerate++;
+            return;
+        }
+        float inv = 1.0f / out[k].w;
+        screen[k] = { out[k].x * inv, out[k].y * inv, out[k].z * inv };
+    }
+
+    // the pieces share the polygon's winding, so one area test covers them all
+    float area = 0;
+    for (int k = 1; k + 1 < count; k++) {
+        const Vec3& v0 = screen[0], & v1 = screen[k], & v2 = screen[k + 1];
+        area += (v2.x - v0.x) * (v1.y - v0.y) - (v2.y - v0.y) * (v1.x - v0.x);
+    }
+    if (area < 0) { stats.backfacing++; return; }
+    if (!(area > 0)) { stats.degenerate++; return; }
+    for (int k = 1; k + 1 < count; k++) {
+        size_t emitted = prims.size();
+        if (EmitTriangle(screen[0], screen[k], screen[k + 1], color, state)) stats.rasterized++;
+        if (attributes) {
+            const ClipVertex* c[3] = { &out[0], &out[k], &out[k + 1] };
+            Corner corners[3];
+            for (int n = 0; n < 3; n++) corners[n] = { c[n]->s, c[n]->u, c[n]->v, 1.0f / c[n]->w };
+            SetAttributes(emitted, *attributes, corners);
+        }
+    }
+}
+
+void RenderPipeline::SubmitIndexed(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, Color color, RasterState state)
+{
+    SubmitBatch(tv, 0, tv.Size(), indices, indexCount, [color](size_t) { return color; }, nullptr, state);
+}
+
+void RenderPipeline::SubmitIndexed(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, const Color* triangleColors, RasterState state)
+{
+    SubmitBatch(tv, 0, tv.Size(), indices, indexCount, [triangleColors](size_t t) { return triangleColors[t]; }, nullptr, state);
+}
+
+void RenderPipeline::SubmitIndexed(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, Color color, const VertexAttributes& attributes, RasterState state)
+{
+    SubmitBatch(tv, 0, tv.Size(), indices, indexCount, [color](size_t) { return color; }, &attributes, state);
+}
+
+void RenderPipeline::SubmitInstances(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, const Color* triangleColors, RasterState state)
+{
+    const size_t vertexCount = tv.sourceCount, triCount = indexCount / 3;
+    for (size_t k = 0; k < tv.mvp.size(); k++) {
+        const Color* colors = triangleColors + k * triCount;
+        SubmitBatch(tv, k * vertexCount, vertexCount, indices, indexCount, [colors](size_t t) { return colors[t]; }, nullptr, state);
+    }
+}
+
+void RenderPipeline::SubmitInstances(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, Color color, const VertexAttributes& attributes, RasterState state)
+{
+    const size_t vertexCount = tv.sourceCount;
+    for (size_t k = 0; k < tv.mvp.size(); k++)
+        SubmitBatch(tv, k * vertexCount, vertexCount, indices, indexCount, [color](size_t) { return color; }, &attributes, state);
+}
+
+void RenderPipeline::SubmitLine(const Vec3& a, const Vec3& b, Color color)
+{
+    int x0 = (int)a.x, y0 = (int)a.y;
+    int x1 = (int)b.x, y1 = (int)b.y;
+
+    RasterPrimitive p;
+    p.minX = std::max(0, std::min(x0, x1));
+    p.maxX = std::min(target.width - 1, std::max(x0, x1));
+    p.minY = std::max(0, std::min(y0, y1));
+    p.maxY = std::min(target.height - 1, std::max(y0, y1));
+    if (p.minX > p.maxX || p.minY > p.maxY) return;
+
+    p.v0 = a; p.v1 = b; p.v2 = b;
+    p.color = PackColor(color);
+    p.type = PrimitiveType::Line;
+    p.state = { false, false };
+    p.shading = RasterShading::Flat;
+    p.group = 0;
+    p.object = NoObject; // lines write neither depth nor ids
+    prims.push_back(p);
+}
+
+void RenderPipeline::SetSky(const Vec3& rotation, const Color faceColors[6])
+{
+    // view space -> sky space: the camera's rotation, then the inverse of the sky's
+    Mat4 cam = Mat4::FromTransform({ { 0,0,0 }, frameCamera.rotation, 1.0f });
+    Mat4 rot = Mat4::FromTransform({ { 0,0,0 }, rotation, 1.0f });
+    auto toSky = [&](const Vec3& v) {
+        Vec3 w = cam.TransformPoint(v);
+        return Vec3{ rot.m[0][0] * w.x + rot.m[1][0] * w.y + rot.m[2][0] * w.z,
+                     rot.m[0][1] * w.x + rot.m[1][1] * w.y + rot.m[2][1] * w.z,
+                     rot.m[0][2] * w.x + rot.m[1][2] * w.y + rot.m[2][2] * w.z };
+    };
+
+    // every orthographic pixel looks straight ahead; a perspective one along
+    // ((x - cx) / focal, (y - cy) / focal, 1)
+    if (frameCamera.projection == ProjectionType::Orthographic) {
+        sky.dir0 = toSky({ 0, 0, 1 });
+        sky.dirDx = sky.dirDy = { 0, 0, 0 };
+    }
+    else {
+        float cx = target.width / 2.0f, cy = target.height / 2.0f;
+        float focal = cy / std::tan(frameCamera.fovY * 0.5f);
+        sky.dir0 = toSky({ -cx / focal, -cy / focal, 1 });
+        sky.dirDx = toSky({ 1 / focal, 0, 0 });
+        sky.dirDy = toSky({ 0, 1 / focal, 0 });
+    }
+    for (int i = 0; i < 6; i++) sky.faceColor[i] = PackColor(faceColors[i]);
+    hasSky = target.framebuffer != nullptr;
+}
+
+void RenderPipeline::SetShadowMap(const ShadowMap& map)
+{
+    // pixel -> world through the inverse of this frame's projection, then into the map
+    shadow.screenToLight = map.GetViewProjection() * viewProj.Inverse();
+    shadow.depth = map.GetDepth();
+    shadow.size = map.GetSize();
+    shadow.bias = map.GetBias();
+    hasShadow = target.framebuffer != nullptr;
+}
+
+void RenderPipeline::SetOutline(Color color, bool objectIds)
+{
+    outline = { PackColor(color), objectIds };
+    if (objectIds && !target.objectIds) {
+        // cleared tile by tile by the next Flush, before anything is drawn over it
+        std::vector<uint32_t>& ids = frames[currentFrame].idBuffer;
+        ids.resize(PlanePixels(target.width, target.height, layout));
+        target.objectIds = ids.data();
+        idsCleared = false;
+    }
+    hasOutline = target.framebuffer != nullptr;
+}
+
+void RenderPipeline::SetDepthBias(float constant, float slope, float maxSlope)
+{
+    depthBias = { constant, slope, maxSlope };
+}
+
+void RenderPipeline::Flush()
+{
+    if ((prims.empty() && !hasSky && !hasShadow && !hasOutline) || tilesX == 0 || tilesY == 0) return;
+    // pipelined, the other batch is the one that may be drawing
+    Batch& batch = batches[nextBatch];
+    batch.prims.swap(prims);
+    batch.texturings.swap(texturings);
+    batch.groups.swap(groups);
+    batch.target = target;
+    batch.tilesY = tilesY;
+    batch.frame = currentFrame;
+    batch.clearIds = target.objectIds && !idsCleared;
+    batch.sky = sky;
+    batch.hasSky = hasSky;
+    batch.shadow = shadow;
+    batch.hasShadow = hasShadow;
+    batch.outline = outline;
+    batch.hasOutline = hasOutline;
+    Bin(batch);
+
+#ifdef CHOMP_PROFILE
+    // triangles submitted since the last Flush of this pass
+    Profiler::Get().AddTriangles(stats.triangles - profiledStats.triangles,
+        stats.outside + stats.backfacing + stats.degenerate - profiledStats.outside - profiledStats.backfacing - profiledStats.degenerate,
+        stats.rasterized - profiledStats.rasterized);
+#endif
+    profiledStats = stats;
+    idsCleared = true;
+    hasShadow = false; // darkening twice would not be idempotent
+
+    if (rasterPool) {
+        WaitForRaster();
+        batch.uncounted = true;
+        {
+            std::lock_guard<std::mutex> lock(rasterMutex);
+            queued = &batch;
+        }
+        rasterChanged.notify_all();
+        nextBatch ^= 1;
+    }
+    else {
+        Rasterize(batch, pool);
+        CountPixels(batch);
+        // nothing is left drawing them, so the next batch fills the same (still cached) vectors
+        batch.prims.swap(prims);
+        batch.texturings.swap(texturings);
+        batch.groups.swap(groups);
+    }
+    prims.clear();
+    texturings.clear();
+    groups.assign(1, RasterGroup{});
+}
+
+void RenderPipeline::Finish()
+{
+    WaitForRaster();
+}
+
+void RenderPipeline::WaitForRaster()
+{
+    if (rasterPool) {
+        std::unique_lock<std::mutex> lock(rasterMutex);
+        rasterChanged.wait(lock, [this]() { return queued == nullptr; });
+    }
+    for (Batch& b : batches)
+        if (b.uncounted) CountPixels(b);
+}
+
+void RenderPipeline::CountPixels(Batch& batch)
+{
+    RasterStats flushed;
+    for (const RasterStats& s : batch.tileStats) {
+        flushed.pixelsTested += s.pixelsTested;
+        flushed.pixelsWritten += s.pixelsWritten;
+    }
+    RasterStats& counted = frames[batch.frame].rasterStats;
+    counted.pixelsTested += flushed.pixelsTested;
+    counted.pixelsWritten += flushed.pixelsWritten;
+#ifdef CHOMP_PROFILE
+    Profiler::Get().AddPixels(flushed.pixelsTested, flushed.pixelsWritten);
+#endif
+    batch.uncounted = false;
+}
+
+void RenderPipeline::RasterLoop()
+{
+    std::unique_lock<std::mutex> lock(rasterMutex);
+    for (;;) {
+        rasterChanged.wait(lock, [this]() { return queued != nullptr || stopping; });
+        if (!queued) return;
+        Batch* batch = queued;
+        lock.unlock();
+        Rasterize(*batch, *rasterPool);
+        lock.lock();
+        queued = nullptr;
+        rasterChanged.notify_all();
+    }
+}
+
+// Bin: each chunk sets up its own primitives and sorts them into private per-tile lists
+void RenderPipeline::Bin(Batch& batch)
+{
+    // a pass without color is a shadow map
+    CHOMP_PROFILE_SCOPE(batch.target.framebuffer ? ProfileStage::Raster : ProfileStage::Shadow);
+
+    const int tileCount = batch.target.tilesX * batch.tilesY;
+    const size_t primCount = batch.prims.size();
+    int chunks = (int)std::min<size_t>(pool.GetThreadCount(), (primCount + MinChunkSize - 1) / MinChunkSize);
+    batch.chunks = chunks = std::max(chunks, 1);
+    if (batch.bins.size() < (size_t)chunks * tileCount) batch.bins.resize((size_t)chunks * tileCount);
+
+    pool.ParallelFor(chunks, [&](int c) {
+        std::vector<uint32_t>* chunkBins = &batch.bins[(size_t)c * tileCount];
+        for (int t = 0; t < tileCount; t++) chunkBins[t].clear();
+
+        size_t begin = primCount * c / chunks;
+        size_t end = primCount * (c + 1) / chunks;
+        for (size_t i = begin; i < end; i++) {
+            RasterPrimitive& p = batch.prims[i];
+            if (p.type == PrimitiveType::Triangle) SetupTriangle(p, batch.texturings.data(), depthBias);
+
+            int tx0 = p.minX / TileSize, tx1 = p.maxX / TileSize;
+            int ty0 = p.minY / TileSize, ty1 = p.maxY / TileSize;
+            for (int ty = ty0; ty <= ty1; ty++)
+                for (int tx = tx0; tx <= tx1; tx++)
+                    chunkBins[ty * batch.target.tilesX + tx].push_back((uint32_t)i);
+        }
+        });
+}
+
+// Raster: one tile per job, walking the chunks in order to keep submission order
+void RenderPipeline::Rasterize(Batch& batch, ThreadPool& workers)
+{
+    CHOMP_PROFILE_SCOPE(batch.target.framebuffer ? ProfileStage::Raster : ProfileStage::Shadow);
+    const RasterTarget& target = batch.target;
+    const int tilesX = target.tilesX;
+    const int tileCount = tilesX * batch.tilesY;
+    batch.tileStats.assign(tileCount, RasterStats());
+
+    workers.ParallelFor(tileCount, [&](int t) {
+        int tx = t % tilesX, ty = t / tilesX;
+        TileRect rect = { tx * TileSize, ty * TileSize,
+            std::min((tx + 1) * TileSize, target.width), std::min((ty + 1) * TileSize, target.height) };
+
+        // tiles start on a multiple of 8, so each run of 8 is contiguous in either layout
+        if (batch.clearIds)
+            for (int y = rect.y0; y < rect.y1; y++)
+                for (int x = rect.x0; x < rect.x1; x += 8)
+                    std::fill_n(target.objectIds + target.address(x, y), std::min(8, rect.x1 - x), NoObject);
+
+        for (int c = 0; c < batch.chunks; c++) {
+            const std::vector<uint32_t>& bin = batch.bins[(size_t)c * tileCount + t];
+            if (!bin.empty())
+                RasterizeTile(target, rect, batch.prims.data(), batch.texturings.data(), batch.groups.data(),
+                    bin.data(), bin.size(), batch.tileStats[t]);
+        }
+        // the tile's depth is still in cache
+        if (batch.hasShadow) ShadowTile(target, rect, batch.shadow);
+        if (batch.hasSky) FillSkyTile(target, rect, batch.sky);
+        });
+
+    // outlines read the neighbouring tiles' depth, so they wait for every tile
+    if (batch.hasOutline) {
+        CHOMP_PROFILE_SCOPE(ProfileStage::Outline);
+        int bands = (target.height + OutlineBand - 1) / OutlineBand;
+        workers.ParallelFor(bands, [&](int b) {
+            OutlineRows(target, b * OutlineBand, std::min((b + 1) * OutlineBand, target.height), batch.outline);
+            });
+    }
+}
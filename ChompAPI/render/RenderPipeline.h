@@ -0,0 +1,238 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "Camera.h"
+#include "VertexStage.h"
+
+class ShadowMap;
+
+// Per-frame counts from the cull and clip stage, reset by Begin
+struct CullStats {
+    size_t objectsTested = 0;  // bounding spheres checked by IsVisible
+    size_t objectsCulled = 0;  // ...and found wholly outside the frustum
+    size_t triangles = 0;      // triangles submitted by objects that were drawn
+    size_t outside = 0;        // wholly beyond one frustum plane, behind the near plane included
+    size_t backfacing = 0;
+    size_t degenerate = 0;     // zero (or undefined) screen area
+    size_t nearClipped = 0;    // crossed the near plane and were cut back to it
+    size_t rasterized = 0;     // triangles handed to the rasterizer, clipped pieces included
+};
+
+// Per-vertex inputs of an indexed batch beyond its positions; any may be null.
+// shade is indexed like the TransformedVertices (Gouraud, in [0, 1]); texU and
+// texV per source vertex, shared by every instance, address texture, which must
+// stay alive until Flush.
+struct VertexAttributes {
+    const float* shade = nullptr;
+    const float* texU = nullptr;
+    const float* texV = nullptr;
+    const RasterTexture* texture = nullptr;
+};
+
+// Collects screen-space primitives for a frame, sorts them into fixed-size
+// screen tiles and rasterizes the tiles in parallel. Each tile owns its part
+// of the framebuffer/zbuffer, so workers never share a pixel. Within a tile
+// primitives are drawn in submission order, so the image matches a serial draw.
+//
+// Pipelined, Flush only sets up and bins its primitives, then hands them to a
+// raster thread with its own workers and returns: the caller submits the next
+// batch (the next frame) while this one is drawn. One batch waits at most, so
+// Flush first waits for the one before, and a frame lags by no more than one.
+class RenderPipeline {
+public:
+    static const int TileSize = 64;
+    static_assert(TileSize == 8 * DepthBlockSize, "a tile's depth blocks must fit its 64-bit dirty mask");
+
+    Camera camera; // read at Begin
+
+    // Pipelined, about a quarter of threadCount set up and bin (the caller
+    // included) and the rest rasterize, the raster thread included
+    explicit RenderPipeline(unsigned threadCount = 0, bool pipelined = false);
+    ~RenderPipeline();
+
+    RenderPipeline(const RenderPipeline&) = delete;
+    RenderPipeline& operator=(const RenderPipeline&) = delete;
+
+    // A null framebuffer makes a depth-only pass (shadow maps): triangles write depth alone
+    void Begin(int* framebuffer, float* zbuffer, int width, int height);
+    // Any format and layout; the depth must be cleared (ClearDepth) or hold an earlier pass.
+    // Pipelined, the last Flush into a target may still be drawing it when Begin
+    // returns: clear, read or present it only once the next Flush (or Finish) has.
+    void Begin(const RenderTarget& target);
+
+    // Transform stage: one model-view-projection matrix per call, then a SIMD pass
+    // over the whole buffer. The result stays valid until the next call.
+    const TransformedVertices& TransformVertices(const Transform& t, const VertexBuffer& vertices);
+    const TransformedVertices& TransformVertices(const Mat4& model, const VertexBuffer& vertices);
+    const TransformedVertices& TransformVertices(const Mat4& model, const float* x, const float* y, const float* z, size_t count);
+    // Instanced transform: each model matrix applied to the same source vertices,
+    // with the output laid out one instance after another
+    const TransformedVertices& TransformInstances(const Mat4* models, size_t instanceCount, const float* x, const float* y, const float* z, size_t count);
+
+    // Frustum test for an object's bounding sphere (in model space) before it is
+    // transformed; false means none of it can be on screen
+    bool IsVisible(const Mat4& model, const BoundingSphere& bounds);
+
+    // Frustum test for a world-space box. planes has one bit per frustum plane left
+    // to test (start from AllPlanes); the bits of planes the box is wholly inside are
+    // cleared, so boxes nested in it can skip them.
+    static const uint8_t AllPlanes = 0x3F;
+    bool IsBoxVisible(const Vec3& lo, const Vec3& hi, uint8_t& planes) const;
+
+    void SubmitTriangle(const Vec3& p0, const Vec3& p1, const Vec3& p2, Color color, RasterState state = {});
+    // Indexed triangles over a TransformedVertices array, either one color or one per triangle.
+    // Triangles wholly outside the frustum, back-facing or zero-area are dropped, and ones
+    // crossing the near plane are clipped to it. Depth-tested batches also record their
+    // screen bounds so hidden objects are skipped whole.
+    void SubmitIndexed(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, Color color, RasterState state = {});
+    void SubmitIndexed(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, const Color* triangleColors, RasterState state = {});
+    // Gouraud and textured: per-vertex shades and texture coordinates interpolated
+    // across each triangle, clipped pieces included. A textured triangle takes its
+    // colors from the texture rather than color.
+    void SubmitIndexed(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, Color color, const VertexAttributes& attributes, RasterState state = {});
+    // The same index list once per instance of a TransformInstances result; triangleColors
+    // holds every triangle's color for the first instance, then the second, and so on.
+    // Each instance is culled and depth-grouped on its own.
+    void SubmitInstances(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, const Color* triangleColors, RasterState state = {});
+    // Gouraud or textured instances: shades are laid out like tv, one instance after another
+    void SubmitInstances(const TransformedVertices& tv, const uint32_t* indices, size_t indexCount, Color color, const VertexAttributes& attributes, RasterState state = {});
+    void SubmitLine(const Vec3& a, const Vec3& b, Color color);
+    // Sky cube for this frame, until the next Begin. Flush colors every pixel that no
+    // depth write reached by the cube face its view direction points at, tile by tile
+    // after the tile is rasterized, so the framebuffer needs no clear and no pixel is
+    // drawn twice. faceColors are +z, -z, -x, +x, +y, -y of the cube turned by rotation.
+    void SetSky(const Vec3& rotation, const Color faceColors[6]);
+    // Shadows for the next Flush, which darkens each tile's covered pixels that lie
+    // behind the map; set it before the frame's last Flush. The map must already be
+    // rendered (ShadowMap::End) and stay alive until then.
+    void SetShadowMap(const ShadowMap& map);
+    // Outlines for this frame, until the next Begin: once Flush has rasterized every
+    // tile, a filter over the depth buffer draws color along silhouettes and depth
+    // breaks, in parallel bands of rows. With objectIds each submitted batch also
+    // writes its own id wherever it writes depth, so touching objects at similar
+    // depths are separated too; the ids start out as NoObject every frame.
+    void SetOutline(Color color, bool objectIds = false);
+    // Depth offset for this frame's triangles, until the next Begin (RasterDepthBias)
+    void SetDepthBias(float constant, float slope, float maxSlope);
+    void Flush();
+    // Returns once every Flush has been drawn; Flush already has when not pipelined
+    void Finish();
+
+    // Screen pixels spanned by one world unit at the near side of a world-space
+    // sphere: the camera zoom for orthographic views, focal length over depth otherwise
+    float PixelsPerUnit(const Vec3& center, float radius) const;
+    // How far ahead of the camera a world-space point lies, along its view axis
+    float ViewDepth(const Vec3& p) const { return viewZ[0] * p.x + viewZ[1] * p.y + viewZ[2] * p.z + viewZ[3]; }
+
+    const Mat4& GetViewProjection() const { return viewProj; }
+    int GetWidth() const { return target.width; }
+    int GetHeight() const { return target.height; }
+    bool IsPipelined() const { return rasterPool != nullptr; }
+    unsigned GetThreadCount() const { return pool.GetThreadCount() + (rasterPool ? rasterPool->GetThreadCount() : 0); }
+    const CullStats& GetCullStats() const { return stats; }
+    // Pixel counts of every Flush since Begin, or with previous, of the Begin before.
+    // Pipelined, a Flush counts once it has been drawn, so the previous pass is
+    // complete once this one's first Flush has returned.
+    const RasterStats& GetRasterStats(bool previous = false) const { return frames[previous ? currentFrame ^ 1 : currentFrame].rasterStats; }
+
+private:
+    // What the raster stage of one Flush reads and writes
+    struct Batch {
+        RasterTarget target{};
+        int tilesY = 0;
+        int chunks = 0;
+        int frame = 0;           // FrameState it draws into
+        bool clearIds = false;   // reset objectIds tile by tile first
+        bool uncounted = false;  // drawn (or drawing) and not yet added to rasterStats
+        std::vector<RasterPrimitive> prims;
+        std::vector<RasterTexturing> texturings;
+        std::vector<RasterGroup> groups;
+        // one bin list per (chunk, tile); chunks are contiguous runs of prims
+        std::vector<std::vector<uint32_t>> bins;
+        std::vector<RasterStats> tileStats;
+        RasterSky sky{};
+        bool hasSky = false;
+        RasterShadow shadow{};
+        bool hasShadow = false;
+        RasterOutline outline{};
+        bool hasOutline = false;
+    };
+    // What the raster stage of a pass writes besides the target. Passes alternate
+    // between two, so a pipelined pass can begin while the last one is drawn.
+    struct FrameState {
+        std::vector<float> blockMaxZ;
+        std::vector<uint64_t> tileDirty;
+        std::vector<uint32_t> idBuffer; // per pixel, when outlines use object ids
+        RasterStats rasterStats;
+    };
+
+    ThreadPool pool; // pipelined, setup and binning only
+    std::unique_ptr<ThreadPool> rasterPool;
+    std::thread rasterThread;
+    std::mutex rasterMutex;
+    std::condition_variable rasterChanged;
+    Batch* queued = nullptr; // handed to the raster thread and not yet drawn
+    bool stopping = false;
+    Batch batches[2];
+    int nextBatch = 0;
+    FrameState frames[2];
+    int currentFrame = 0;
+
+    RasterTarget target{};
+    TargetLayout layout = TargetLayout::Linear; // of target's planes
+    int tilesX = 0, tilesY = 0;
+    Mat4 viewProj = Mat4::Identity();
+    Camera frameCamera; // camera as of Begin
+    float viewZ[4] = {}; // row of its view matrix giving view-space z
+    float frustum[6][4] = {}; // world-space planes, normalized, inside where positive
+    TransformedVertices transformed;
+    std::vector<uint8_t> outcodes; // per vertex of the batch being submitted
+    CullStats stats;
+    CullStats profiledStats; // stats as of the last Flush, for the profiler's per-frame counts
+
+    std::vector<RasterPrimitive> prims;
+    std::vector<RasterTexturing> texturings; // of the Textured prims
+    std::vector<RasterGroup> groups; // [0] is the "no group" entry
+    uint32_t currentGroup = 0;       // stamped on primitives as they are submitted
+    RasterSky sky{};
+    bool hasSky = false;
+    RasterShadow shadow{};
+    bool hasShadow = false;
+    RasterOutline outline{};
+    bool hasOutline = false;
+    RasterDepthBias depthBias{};
+    bool idsCleared = false;         // idBuffer reset to NoObject since Begin
+    uint32_t currentObject = NoObject; // stamped like currentGroup, one per batch
+    uint32_t objectCount = 0;
+
+    uint8_t BeginBatch(const TransformedVertices& tv, size_t first, size_t n, RasterState state);
+    // null attributes keep the batch flat
+    template <typename ColorOf>
+    void SubmitBatch(const TransformedVertices& tv, size_t first, size_t vertexCount,
+        const uint32_t* indices, size_t indexCount, ColorOf colorOf, const VertexAttributes* attributes, RasterState state);
+    void SubmitNearClipped(const TransformedVertices& tv, size_t first, const uint32_t* tri, Color color, const VertexAttributes* attributes, RasterState state);
+    void AddTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color, RasterState state);
+    bool EmitTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, Color color, RasterState state);
+    // A triangle corner's attributes, invW being one over its clip-space w
+    struct Corner {
+        float shade, u, v, invW;
+    };
+    // Gives the primitives emitted since prims held first the batch's attributes,
+    // with these values at their three corners; SetShades when there are only shades
+    void SetAttributes(size_t first, const VertexAttributes& attributes, const Corner corners[3]);
+    void SetShades(size_t first, float s0, float s1, float s2);
+    // ...with the corners of triangle tri of a batch starting at vertex first of tv
+    void SetAttributes(size_t emitted, const VertexAttributes& attributes, const TransformedVertices& tv, size_t first, const uint32_t* tri);
+    void Bin(Batch& batch);
+    void Rasterize(Batch& batch, ThreadPool& workers);
+    void RasterLoop();
+    // Waits for the raster thread to go idle, then counts what it drew
+    void WaitForRaster();
+    void CountPixels(Batch& batch);
+};
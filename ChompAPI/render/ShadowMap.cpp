@@ -0,0 +1,54 @@
+#include "ShadowMap.h"
+#include "RenderPipeline.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+// Casters are drawn pushed back by their own depth slope across a texel (a lit
+// point can lie anywhere in the texel its surface was sampled at the center of),
+// capped so grazing surfaces do not lift shadows off their casters. Depth per
+// texel is the depth a 45 degree slope covers in one texel.
+static const float SlopeBias = 1.0f;
+static const float MaxSlopeBiasTexels = 16.0f;
+// what the main pass may sit behind the map from float rounding alone
+static const float BiasTexels = 0.25f;
+
+ShadowMap::ShadowMap(int size)
+    : size(std::max(size, 1))
+{
+    depth[0].resize((size_t)this->size * this->size);
+}
+
+void ShadowMap::Begin(RenderPipeline& pipeline, const BoundingSphere& casters)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Shadow);
+    float len = std::sqrt(lightDir.x * lightDir.x + lightDir.y * lightDir.y + lightDir.z * lightDir.z);
+    Vec3 forward = len > 0 ? lightDir * (-1.0f / len) : Vec3{ 0, 0, 1 };
+    float radius = std::max(casters.radius, 1e-6f);
+
+    // an orthographic camera at the sphere's center whose view +z runs along the
+    // light: rotating x then y takes +z to (sin y cos x, -sin x, cos y cos x)
+    Camera light = Camera::Orthographic(size / (2.0f * radius), -radius, radius);
+    light.position = casters.center;
+    light.rotation = { std::asin(std::clamp(-forward.y, -1.0f, 1.0f)), std::atan2(forward.x, forward.z), 0 };
+    bias = BiasTexels / size;
+
+    savedCamera = pipeline.camera;
+    pipeline.camera = light;
+    if (pipeline.IsPipelined()) {
+        current ^= 1;
+        depth[current].resize((size_t)size * size);
+    }
+    std::vector<float>& map = depth[current];
+    ClearDepth(map.data(), DepthFormat::Float32, map.size());
+    pipeline.Begin(nullptr, map.data(), size, size);
+    pipeline.SetDepthBias(0, SlopeBias, MaxSlopeBiasTexels / size);
+}
+
+void ShadowMap::End(RenderPipeline& pipeline)
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Shadow);
+    pipeline.Flush();
+    viewProj = pipeline.GetViewProjection();
+    pipeline.camera = savedCamera;
+}
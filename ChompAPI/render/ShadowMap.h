@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "Camera.h"
+
+class RenderPipeline;
+
+// Depth of the scene as seen from a directional light, rendered once per frame
+// through the pipeline's depth-only path. The main pass then darkens the pixels
+// that lie behind it (RenderPipeline::SetShadowMap), so shadows cost one lookup
+// per covered pixel however many triangles cast them.
+class ShadowMap {
+public:
+    Vec3 lightDir = { 0.5f, 1.0f, -0.5f }; // towards the light, need not be normalized
+
+    explicit ShadowMap(int size = 1024);
+
+    // Points pipeline at the map, looking along the light over a world-space sphere
+    // that must hold every caster. Draw the casters, then call End.
+    void Begin(RenderPipeline& pipeline, const BoundingSphere& casters);
+    // Flushes the casters and hands pipeline back its own camera
+    void End(RenderPipeline& pipeline);
+
+    int GetSize() const { return size; }
+    const float* GetDepth() const { return depth[current].data(); }
+    // World space to map pixels and light depth in [0, 1]
+    const Mat4& GetViewProjection() const { return viewProj; }
+    // Depth a point may sit behind the map and still count as lit, in map depth units
+    float GetBias() const { return bias; }
+
+private:
+    int size;
+    // a pipelined pass alternates between two, so one is cleared and drawn while
+    // the last frame still reads the other
+    std::vector<float> depth[2];
+    int current = 0;
+    Mat4 viewProj = Mat4::Identity();
+    float bias = 0;
+    Camera savedCamera;
+};
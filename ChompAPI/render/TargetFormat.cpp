@@ -0,0 +1,38 @@
+#include "TargetFormat.h"
+#include <algorithm>
+
+// Each output row takes a row of 8 pixels from every square of its band, a
+// fixed-size copy the compiler turns into vector moves; the band's squares stay
+// in cache across its 8 rows
+template <size_t Bytes>
+static void ResolveTiled(const RenderTarget& target, uint8_t* linear, size_t pitch, int y0, int y1)
+{
+    const PixelAddress a = AddressOf(target.width, target.layout);
+    const int w = target.width, full = w & ~(TargetTileSize - 1);
+    const size_t squareBytes = TargetTileSize * TargetTileSize * Bytes, rowBytes = TargetTileSize * Bytes;
+    for (int band = y0 & ~(TargetTileSize - 1); band < y1; band += TargetTileSize) {
+        int r0 = std::max(band, y0) - band, r1 = std::min(band + TargetTileSize, y1) - band;
+        const uint8_t* square = (const uint8_t*)target.color + a.Row(band) * Bytes;
+        for (int r = r0; r < r1; r++) {
+            uint8_t* out = linear + (size_t)(band + r) * pitch * Bytes;
+            const uint8_t* in = square + r * rowBytes;
+            int x = 0;
+            for (; x < full; x += TargetTileSize, in += squareBytes)
+                std::memcpy(out + x * Bytes, in, rowBytes);
+            if (x < w) std::memcpy(out + x * Bytes, in, (size_t)(w - x) * Bytes);
+        }
+    }
+}
+
+void ResolveColor(const RenderTarget& target, void* linear, size_t pitch, int y0, int y1)
+{
+    const size_t bytes = ColorBytes(target.colorFormat);
+    if (target.layout == TargetLayout::Linear) {
+        for (int y = y0; y < y1; y++)
+            std::memcpy((uint8_t*)linear + (size_t)y * pitch * bytes, (const uint8_t*)target.color + (size_t)y * target.width * bytes,
+                (size_t)target.width * bytes);
+        return;
+    }
+    if (bytes == 2) ResolveTiled<2>(target, (uint8_t*)linear, pitch, y0, y1);
+    else ResolveTiled<4>(target, (uint8_t*)linear, pitch, y0, y1);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Pixel layouts a render target can use. Narrower formats halve the bytes every
+// clear, depth test and color write moves, at some cost in precision.
+enum class ColorFormat : uint8_t {
+    XRGB8888, // 32-bit 0x00RRGGBB
+    RGB565    // 16-bit, 5/6/5 bits
+};
+
+enum class DepthFormat : uint8_t {
+    Float32,
+    Unorm24, // depth * 0xFFFFFF in a 32-bit word
+    Unorm16  // depth * 0xFFFE
+};
+
+// Order of the pixels in a plane. Linear packs rows top to bottom. Tiled stores
+// TargetTileSize squares row by row, each square's pixels row by row, so a tall
+// triangle touches one or two cache lines per square it crosses rather than one
+// per row; planes are padded to whole squares, and only ResolveColor turns one
+// back into rows.
+enum class TargetLayout : uint8_t {
+    Linear,
+    Tiled
+};
+
+static const int TargetTileSize = 8;
+
+// Where pixel (x, y) lies in a plane of either layout, without a branch: Row(y) + Column(x).
+// Eight pixels starting at a multiple of 8 are always contiguous.
+struct PixelAddress {
+    size_t bandStride; // elements from one band of 8 rows to the next
+    size_t rowStride;  // ...from one row of a band to the next
+    int columnShift;   // log2 of the elements from one group of 8 columns to the next
+
+    size_t Row(int y) const { return (size_t)(y >> 3) * bandStride + (size_t)(y & 7) * rowStride; }
+    size_t Column(int x) const { return ((size_t)(x >> 3) << columnShift) + (size_t)(x & 7); }
+    size_t operator()(int x, int y) const { return Row(y) + Column(x); }
+};
+static_assert(TargetTileSize == 8, "PixelAddress splits coordinates into groups of 8");
+
+inline int PaddedSize(int size, TargetLayout layout)
+{
+    return layout == TargetLayout::Tiled ? (size + TargetTileSize - 1) & ~(TargetTileSize - 1) : size;
+}
+
+inline PixelAddress AddressOf(int width, TargetLayout layout)
+{
+    if (layout == TargetLayout::Tiled)
+        return { (size_t)PaddedSize(width, layout) * TargetTileSize, TargetTileSize, 6 };
+    return { (size_t)width * TargetTileSize, (size_t)width, 3 };
+}
+
+// Elements in a plane of a width * height target, padding included
+inline size_t PlanePixels(int width, int height, TargetLayout layout)
+{
+    return (size_t)PaddedSize(width, layout) * PaddedSize(height, layout);
+}
+
+// Color and depth planes of one frame, width * height pixels each, in layout
+struct RenderTarget {
+    void* color;
+    void* depth;
+    int width, height;
+    ColorFormat colorFormat = ColorFormat::XRGB8888;
+    DepthFormat depthFormat = DepthFormat::Float32;
+    TargetLayout layout = TargetLayout::Linear;
+};
+
+inline size_t ColorBytes(ColorFormat f) { return f == ColorFormat::RGB565 ? 2 : 4; }
+inline size_t DepthBytes(DepthFormat f) { return f == DepthFormat::Unorm16 ? 2 : 4; }
+
+// Every format's "nothing drawn" value is one repeated byte, so a clear is a memset:
+// 0x7F7F7F7F is about 3.4e38 as a float and above any 24-bit depth as an integer,
+// and 0xFFFF is one above the largest 16-bit depth
+inline int DepthClearByte(DepthFormat f) { return f == DepthFormat::Unorm16 ? 0xFF : 0x7F; }
+
+inline void ClearDepth(void* depth, DepthFormat format, size_t pixels)
+{
+    std::memset(depth, DepthClearByte(format), pixels * DepthBytes(format));
+}
+
+inline void ClearDepth(const RenderTarget& target)
+{
+    ClearDepth(target.depth, target.depthFormat, PlanePixels(target.width, target.height, target.layout));
+}
+
+// Copies rows [y0, y1) of the target's color plane to linear, a row every pitch
+// pixels in the same format; a Linear target's rows are copied as they are
+void ResolveColor(const RenderTarget& target, void* linear, size_t pitch, int y0, int y1);
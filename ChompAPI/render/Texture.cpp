@@ -0,0 +1,111 @@
+#include "Texture.h"
+#include <algorithm>
+#include <cmath>
+
+// nearest power of two to n (rounding up on a tie), within 1..Texture::MaxSize
+static int PowerOfTwoNear(int n)
+{
+    int p = 1;
+    while (p < n && p < Texture::MaxSize) p <<= 1;
+    return p > 1 && p - n > n - p / 2 ? p / 2 : p;
+}
+
+static int Log2(int n)
+{
+    int s = 0;
+    while ((1 << s) < n) s++;
+    return s;
+}
+
+// Bilinear resize of packed pixels, wrapping at the edges as the sampler does
+static std::vector<uint32_t> Resample(const std::vector<uint32_t>& src, int w, int h, int newW, int newH)
+{
+    if (w == newW && h == newH) return src;
+    std::vector<uint32_t> out((size_t)newW * newH);
+    for (int y = 0; y < newH; y++) {
+        float sy = ((float)y + 0.5f) * (float)h / (float)newH - 0.5f;
+        int y0 = (int)std::floor(sy);
+        float fy = sy - (float)y0;
+        int r0 = ((y0 % h) + h) % h, r1 = (r0 + 1) % h;
+        for (int x = 0; x < newW; x++) {
+            float sx = ((float)x + 0.5f) * (float)w / (float)newW - 0.5f;
+            int x0 = (int)std::floor(sx);
+            float fx = sx - (float)x0;
+            int c0 = ((x0 % w) + w) % w, c1 = (c0 + 1) % w;
+            uint32_t p00 = src[(size_t)r0 * w + c0], p10 = src[(size_t)r0 * w + c1];
+            uint32_t p01 = src[(size_t)r1 * w + c0], p11 = src[(size_t)r1 * w + c1];
+            uint32_t pixel = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                float top = (float)(p00 >> shift & 255) * (1 - fx) + (float)(p10 >> shift & 255) * fx;
+                float bottom = (float)(p01 >> shift & 255) * (1 - fx) + (float)(p11 >> shift & 255) * fx;
+                pixel |= (uint32_t)(top * (1 - fy) + bottom * fy + 0.5f) << shift;
+            }
+            out[(size_t)y * newW + x] = pixel;
+        }
+    }
+    return out;
+}
+
+// The next level down: each texel the rounded average of the 2x2 (or 2x1 once a
+// side is down to 1) above it
+static std::vector<uint32_t> HalfSize(const std::vector<uint32_t>& src, int w, int h, int& newW, int& newH)
+{
+    newW = std::max(1, w / 2);
+    newH = std::max(1, h / 2);
+    int sx = w / newW, sy = h / newH, n = sx * sy;
+    std::vector<uint32_t> out((size_t)newW * newH);
+    for (int y = 0; y < newH; y++) {
+        for (int x = 0; x < newW; x++) {
+            uint32_t sum[3] = {};
+            for (int j = 0; j < sy; j++) {
+                for (int i = 0; i < sx; i++) {
+                    uint32_t p = src[(size_t)(y * sy + j) * w + x * sx + i];
+                    sum[0] += p >> 16 & 255; sum[1] += p >> 8 & 255; sum[2] += p & 255;
+                }
+            }
+            out[(size_t)y * newW + x] = ((sum[0] + n / 2) / n) << 16 | ((sum[1] + n / 2) / n) << 8 | (sum[2] + n / 2) / n;
+        }
+    }
+    return out;
+}
+
+Texture::Texture(const uint8_t* rgb, int width, int height)
+{
+    if (!rgb || width <= 0 || height <= 0) return;
+    std::vector<uint32_t> level((size_t)width * height);
+    for (size_t i = 0; i < level.size(); i++)
+        level[i] = (uint32_t)rgb[i * 3] << 16 | (uint32_t)rgb[i * 3 + 1] << 8 | rgb[i * 3 + 2];
+    int w = PowerOfTwoNear(width), h = PowerOfTwoNear(height);
+    level = Resample(level, width, height, w, h);
+
+    // lay every level out tiled, then point the RasterTexture into the one buffer
+    size_t offsets[MaxTextureLevels];
+    int count = 0;
+    while (true) {
+        RasterTextureLevel& l = raster.levels[count];
+        int tilesX = std::max(1, w / TextureTileSize), tilesY = std::max(1, h / TextureTileSize);
+        l.width = w;
+        l.height = h;
+        l.tileRowShift = Log2(tilesX);
+        offsets[count] = texels.size();
+        texels.resize(texels.size() + (size_t)tilesX * tilesY * TextureTileSize * TextureTileSize);
+        uint32_t* out = texels.data() + offsets[count];
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                // same layout as the sampler's TexelIndex
+                int morton = 0;
+                for (int b = 0; b < 3; b++) morton |= ((x >> b & 1) << (2 * b)) | ((y >> b & 1) << (2 * b + 1));
+                size_t tile = ((size_t)(y / TextureTileSize) << l.tileRowShift) + x / TextureTileSize;
+                out[tile * TextureTileSize * TextureTileSize + morton] = level[(size_t)y * w + x];
+            }
+        }
+        count++;
+        if ((w == 1 && h == 1) || count == MaxTextureLevels) break;
+        int halfW, halfH;
+        level = HalfSize(level, w, h, halfW, halfH);
+        w = halfW;
+        h = halfH;
+    }
+    for (int i = 0; i < count; i++) raster.levels[i].texels = texels.data() + offsets[i];
+    raster.levelCount = count;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "Rasterizer.h"
+
+// RGB image ready for the rasterizer's sampler: resampled to a power of two on
+// each side, mip-mapped down to 1x1 with a box filter and stored in the tiled
+// layout RasterTexture describes. It can be moved but not copied, since the
+// RasterTexture points into its own texel storage.
+class Texture {
+public:
+    static const int MaxSize = 1 << (MaxTextureLevels - 1);
+
+    Texture() = default;
+    // width * height pixels of 3 bytes (r, g, b), rows top to bottom; v = 0 is the top row
+    Texture(const uint8_t* rgb, int width, int height);
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+    // the texel buffer moves whole, so the level pointers stay valid
+    Texture(Texture&& o) noexcept : texels(std::move(o.texels)), raster(o.raster) { o.raster = {}; }
+    Texture& operator=(Texture&& o) noexcept {
+        texels = std::move(o.texels);
+        raster = o.raster;
+        o.raster = {};
+        return *this;
+    }
+
+    bool IsValid() const { return raster.levelCount > 0; }
+    int GetWidth() const { return raster.levelCount ? raster.levels[0].width : 0; }
+    int GetHeight() const { return raster.levelCount ? raster.levels[0].height : 0; }
+    // What VertexAttributes::texture points at; valid while this texture lives
+    const RasterTexture* Raster() const { return IsValid() ? &raster : nullptr; }
+
+private:
+    std::vector<uint32_t> texels; // every level, finest first
+    RasterTexture raster{};
+};
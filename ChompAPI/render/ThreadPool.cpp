@@ -0,0 +1,76 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+
+    for (unsigned i = 1; i < threadCount; i++)
+        workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w.join();
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& fn)
+{
+    if (count <= 0) return;
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        next = 0;
+        active = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    RunJobs(fn, count);
+
+    // every worker checks in once per generation, so the job stays alive until then
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return active == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        const std::function<void(int)>* fn;
+        int count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            fn = job;
+            count = jobCount;
+        }
+
+        RunJobs(*fn, count);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) done.notify_one();
+    }
+}
+
+void ThreadPool::RunJobs(const std::function<void(int)>& fn, int count)
+{
+    for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+        fn(i);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Fixed pool of worker threads. ParallelFor hands out indices [0, count)
+// to the workers and the calling thread, and returns once all are done.
+class ThreadPool {
+public:
+    // threadCount = 0 uses one thread per hardware core (caller included)
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void ParallelFor(int count, const std::function<void(int)>& fn);
+    unsigned GetThreadCount() const { return (unsigned)workers.size() + 1; }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> next{ 0 };
+    size_t active = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void WorkerLoop();
+    void RunJobs(const std::function<void(int)>& fn, int count);
+};
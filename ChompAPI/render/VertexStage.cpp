@@ -0,0 +1,76 @@
+#include "VertexStage.h"
+#include "CpuFeatures.h"
+
+static void TransformScalar(const Mat4& m, const float* x, const float* y, const float* z, size_t begin, size_t end,
+    float* outX, float* outY, float* outZ, float* outW)
+{
+    for (size_t i = begin; i < end; i++) {
+        float cx = m.m[0][0] * x[i] + m.m[0][1] * y[i] + m.m[0][2] * z[i] + m.m[0][3];
+        float cy = m.m[1][0] * x[i] + m.m[1][1] * y[i] + m.m[1][2] * z[i] + m.m[1][3];
+        float cz = m.m[2][0] * x[i] + m.m[2][1] * y[i] + m.m[2][2] * z[i] + m.m[2][3];
+        float cw = m.m[3][0] * x[i] + m.m[3][1] * y[i] + m.m[3][2] * z[i] + m.m[3][3];
+        float inv = 1.0f / cw;
+        outX[i] = cx * inv; outY[i] = cy * inv; outZ[i] = cz * inv; outW[i] = cw;
+    }
+}
+
+#ifdef CHOMP_X86
+static size_t TransformSSE(const Mat4& m, const float* x, const float* y, const float* z, size_t count,
+    float* outX, float* outY, float* outZ, float* outW)
+{
+    __m128 r[4][4];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++) r[i][j] = _mm_set1_ps(m.m[i][j]);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        __m128 c[4];
+        for (int k = 0; k < 4; k++)
+            c[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[k][0], vx), _mm_mul_ps(r[k][1], vy)),
+                _mm_add_ps(_mm_mul_ps(r[k][2], vz), r[k][3]));
+        __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), c[3]);
+        _mm_storeu_ps(outX + i, _mm_mul_ps(c[0], inv));
+        _mm_storeu_ps(outY + i, _mm_mul_ps(c[1], inv));
+        _mm_storeu_ps(outZ + i, _mm_mul_ps(c[2], inv));
+        _mm_storeu_ps(outW + i, c[3]);
+    }
+    return i;
+}
+
+CHOMP_TARGET_AVX2
+static size_t TransformAVX2(const Mat4& m, const float* x, const float* y, const float* z, size_t count,
+    float* outX, float* outY, float* outZ, float* outW)
+{
+    __m256 r[4][4];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++) r[i][j] = _mm256_set1_ps(m.m[i][j]);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        __m256 c[4];
+        for (int k = 0; k < 4; k++)
+            c[k] = _mm256_fmadd_ps(r[k][0], vx, _mm256_fmadd_ps(r[k][1], vy, _mm256_fmadd_ps(r[k][2], vz, r[k][3])));
+        __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), c[3]);
+        _mm256_storeu_ps(outX + i, _mm256_mul_ps(c[0], inv));
+        _mm256_storeu_ps(outY + i, _mm256_mul_ps(c[1], inv));
+        _mm256_storeu_ps(outZ + i, _mm256_mul_ps(c[2], inv));
+        _mm256_storeu_ps(outW + i, c[3]);
+    }
+    return i;
+}
+#endif
+
+void TransformVertexRange(const Mat4& mvp, const float* x, const float* y, const float* z, size_t count,
+    float* outX, float* outY, float* outZ, float* outW)
+{
+    size_t done = 0;
+#ifdef CHOMP_X86
+    if (CpuHasAVX2())
+        done = TransformAVX2(mvp, x, y, z, count, outX, outY, outZ, outW);
+    else
+        done = TransformSSE(mvp, x, y, z, count, outX, outY, outZ, outW);
+#endif
+    TransformScalar(mvp, x, y, z, done, count, outX, outY, outZ, outW);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "../objects/Types.h"
+
+// Object-space positions as structure-of-arrays, so whole SIMD registers load at once
+struct VertexBuffer {
+    std::vector<float> x, y, z;
+
+    void Add(const Vec3& v) { x.push_back(v.x); y.push_back(v.y); z.push_back(v.z); }
+    Vec3 Get(size_t i) const { return { x[i], y[i], z[i] }; }
+    size_t Size() const { return x.size(); }
+};
+
+// Post-transform vertices: pixel x/y, depth in [0, 1] and clip-space w
+struct TransformedVertices {
+    std::vector<float> x, y, z, w;
+
+    // what produced them, so a clipper can rebuild exact clip-space positions
+    // for vertices whose divide by w was meaningless: vertex i is source vertex
+    // i % sourceCount under mvp[i / sourceCount] (one matrix per instance)
+    std::vector<Mat4> mvp;
+    const float* srcX = nullptr;
+    const float* srcY = nullptr;
+    const float* srcZ = nullptr;
+    size_t sourceCount = 0;
+
+    Vec3 Screen(size_t i) const { return { x[i], y[i], z[i] }; }
+    size_t Size() const { return x.size(); }
+};
+
+// out[i] = mvp * (x[i], y[i], z[i], 1), divided through by w. Picks the widest SIMD path at runtime.
+void TransformVertexRange(const Mat4& mvp, const float* x, const float* y, const float* z, size_t count,
+    float* outX, float* outY, float* outZ, float* outW);
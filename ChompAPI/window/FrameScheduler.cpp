@@ -0,0 +1,117 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <thread>
+
+static void Push(std::vector<float>& ring, size_t& count, double value)
+{
+    ring[count % ring.size()] = (float)value;
+    count++;
+}
+
+static double Average(const std::vector<float>& ring, size_t count)
+{
+    size_t n = std::min(count, ring.size());
+    if (n == 0) return 0;
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += ring[i];
+    return sum / n;
+}
+
+FrameScheduler::FrameScheduler(double targetFps)
+    : budgetMs(targetFps > 0 ? 1000.0 / targetFps : 0),
+    frameMs(HistorySize), renderMs(HistorySize), presentMs(HistorySize)
+{
+}
+
+void FrameScheduler::SetTargetFps(double fps)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budgetMs = fps > 0 ? 1000.0 / fps : 0;
+    started = false; // re-anchor the deadlines
+}
+
+void FrameScheduler::SetThroughputMode(bool on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    throughput = on;
+    started = false;
+}
+
+bool FrameScheduler::IsThroughputMode() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return throughput;
+}
+
+void FrameScheduler::BeginFrame()
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started) Push(frameMs, frameCount, std::chrono::duration<double, std::milli>(now - frameStart).count());
+    else deadline = now;
+    started = true;
+    frameStart = now;
+}
+
+void FrameScheduler::EndFrame()
+{
+    Clock::time_point now = Clock::now();
+    Clock::time_point wait;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        double ms = std::chrono::duration<double, std::milli>(now - frameStart).count();
+        Push(renderMs, renderCount, ms);
+        frames++;
+        if (throughput || budgetMs <= 0) return;
+
+        if (ms > budgetMs) missed++;
+        deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+        if (deadline <= now) {
+            deadline = now; // overran: start the next frame right away, don't burst to catch up
+            return;
+        }
+        wait = deadline;
+    }
+    WaitUntil(wait);
+}
+
+void FrameScheduler::RecordPresent(double ms)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Push(presentMs, presentCount, ms);
+}
+
+FrameStats FrameScheduler::GetStats() const
+{
+    std::vector<float> frameTimes;
+    FrameStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frameTimes.assign(frameMs.begin(), frameMs.begin() + std::min(frameCount, frameMs.size()));
+        stats.renderAvgMs = Average(renderMs, renderCount);
+        stats.presentAvgMs = Average(presentMs, presentCount);
+        stats.budgetMs = throughput ? 0 : budgetMs;
+        stats.frames = frames;
+        stats.missed = missed;
+    }
+    if (frameTimes.empty()) return stats;
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    stats.minMs = frameTimes.front();
+    stats.maxMs = frameTimes.back();
+    stats.p99Ms = frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100)];
+    double sum = 0;
+    for (float t : frameTimes) sum += t;
+    stats.avgMs = sum / frameTimes.size();
+    return stats;
+}
+
+// Sleeps most of the way, then yields for the last stretch: OS sleeps can
+// overshoot by a millisecond or more, which is a big slice of a 16 ms frame
+void FrameScheduler::WaitUntil(Clock::time_point t)
+{
+    const auto spin = std::chrono::milliseconds(2);
+    Clock::time_point now = Clock::now();
+    if (t - now > spin) std::this_thread::sleep_until(t - spin);
+    while (Clock::now() < t) std::this_thread::yield();
+}
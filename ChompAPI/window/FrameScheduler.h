@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+// Rolling frame-time statistics over the last FrameScheduler::HistorySize frames, in milliseconds
+struct FrameStats {
+    double minMs = 0, avgMs = 0, p99Ms = 0, maxMs = 0; // start-to-start frame interval
+    double renderAvgMs = 0;  // time spent in the frame callback
+    double presentAvgMs = 0; // time spent putting a frame on screen
+    double budgetMs = 0;     // 0 when uncapped
+    uint64_t frames = 0;     // total since start
+    uint64_t missed = 0;     // frames whose render alone overran the budget
+};
+
+// Paces a render loop to a frame budget. Each frame gets a deadline one
+// budget after the previous one; the loop sleeps only for what is left of it
+// and, when a frame overruns, restarts from now instead of trying to catch up.
+class FrameScheduler {
+public:
+    static const int HistorySize = 240;
+
+    explicit FrameScheduler(double targetFps = 60.0);
+
+    void SetTargetFps(double fps); // <= 0 runs uncapped
+    void SetThroughputMode(bool on); // render back to back, ignoring the budget
+    bool IsThroughputMode() const;
+
+    // Render thread: bracket each frame
+    void BeginFrame();
+    void EndFrame(); // sleeps until the frame's deadline
+
+    // Any thread: time spent presenting a frame
+    void RecordPresent(double ms);
+
+    FrameStats GetStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    mutable std::mutex mutex;
+    double budgetMs;
+    bool throughput = false;
+
+    bool started = false;
+    Clock::time_point frameStart, deadline;
+    uint64_t frames = 0, missed = 0;
+
+    // ring buffers
+    std::vector<float> frameMs, renderMs, presentMs;
+    size_t frameCount = 0, renderCount = 0, presentCount = 0;
+
+    static void WaitUntil(Clock::time_point t);
+};
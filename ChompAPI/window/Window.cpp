@@ -1,4 +1,5 @@
 #include "Window.h"
+#include "../render/Profiler.h"
 #include <iostream>
 #include <algorithm>
 #include <chrono>
@@ -27,11 +28,34 @@ LRESULT CALLBACK WinProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 }
 #endif
 
+static uint64_t PackSize(int w, int h)
+{
+    return ((uint64_t)(uint32_t)w << 32) | (uint32_t)h;
+}
+
+static uint32_t PackFormats(ColorFormat color, DepthFormat depth, TargetLayout layout)
+{
+    return ((uint32_t)layout << 16) | ((uint32_t)color << 8) | (uint32_t)depth;
+}
+
+// bytes rounded up to whole 32-bit words, so any format sits in a word vector
+static size_t Words(size_t pixels, size_t bytesPerPixel)
+{
+    return (pixels * bytesPerPixel + 3) / 4;
+}
+
 Window::Window(int w, int h, const std::string& t)
-    : width(w), height(h), title(t), running(false)
+    : requestedSize(PackSize(w, h)), requestedFormats(PackFormats(ColorFormat::XRGB8888, DepthFormat::Float32, TargetLayout::Linear)),
+    title(t), running(false)
 {
-    framebuffer.resize(width * height, 0x000000);
-    zbuffer.resize(width * height, 1e9f);
+    // the pipelined ones are sized by the first frames that use them
+    for (int i = 0; i < 3; i++) {
+        buffers[i].pixels.assign((size_t)w * h, 0x000000);
+        buffers[i].width = w;
+        buffers[i].height = h;
+    }
+    depths[0].values.resize((size_t)w * h);
+    ClearDepth(depths[0].values.data(), depths[0].format, depths[0].values.size());
 
 #ifdef __APPLE__
     isMac = true;
@@ -67,29 +91,75 @@ Window::~Window()
 #endif
 }
 
-int* Window::GetFramebuffer()
+RenderTarget Window::GetRenderTarget()
 {
-    std::lock_guard<std::mutex> lock(bufferMutex);
-    return framebuffer.data();
+    FrameBuffer& b = buffers[back];
+    DepthBuffer& z = depths[backDepth];
+    return { b.pixels.data(), z.values.data(), b.width, b.height, b.format, z.format, b.layout };
 }
 
-float* Window::GetZBuffer()
+int Window::GetWidth() const { return buffers[back].width; }
+int Window::GetHeight() const { return buffers[back].height; }
+
+void Window::HandleResize(int newW, int newH)
 {
-    std::lock_guard<std::mutex> lock(bufferMutex);
-    return zbuffer.data();
+    if (requestedSize.exchange(PackSize(newW, newH)) == PackSize(newW, newH)) return;
+    if (verbose) std::cout << "Resized to " << newW << "x" << newH << std::endl;
 }
 
-int Window::GetWidth() const { return width; }
-int Window::GetHeight() const { return height; }
+void Window::SetFormats(ColorFormat color, DepthFormat depth, TargetLayout layout)
+{
+    requestedFormats.store(PackFormats(color, depth, layout), std::memory_order_relaxed);
+}
 
-void Window::HandleResize(int newW, int newH)
+// Render thread: resize (or reformat) the back buffer if the window changed since the last frame
+void Window::PrepareBackBuffer()
+{
+    uint64_t size = requestedSize.load(std::memory_order_relaxed);
+    uint32_t formats = requestedFormats.load(std::memory_order_relaxed);
+    int w = (int)(size >> 32), h = (int)(uint32_t)size;
+    ColorFormat color = (ColorFormat)((formats >> 8) & 0xFF);
+    DepthFormat depth = (DepthFormat)(formats & 0xFF);
+    TargetLayout layout = (TargetLayout)(formats >> 16);
+    size_t pixels = PlanePixels(w, h, layout);
+    FrameBuffer& b = buffers[back];
+    if (b.width != w || b.height != h || b.format != color || b.layout != layout) {
+        b.pixels.assign(Words(pixels, ColorBytes(color)), 0x000000);
+        b.width = w;
+        b.height = h;
+        b.format = color;
+        b.layout = layout;
+    }
+    // pipelined, the other depth buffer may still be drawn into
+    DepthBuffer& z = depths[backDepth];
+    if (z.format != depth || z.values.size() != Words(pixels, DepthBytes(depth))) {
+        z.values.resize(Words(pixels, DepthBytes(depth)));
+        z.format = depth;
+        ClearDepth(z.values.data(), depth, pixels);
+    }
+}
+
+// Render thread: park the finished frame and take whatever buffer was parked.
+// Pipelined, the frame just recorded is still being drawn, so the one before it
+// is parked instead, and the recorded one waits in pending for the next frame.
+void Window::PublishFrame()
 {
-    std::lock_guard<std::mutex> lock(bufferMutex);
-    if (newW == width && newH == height) return;
-    width = newW; height = newH;
-    framebuffer.resize(width * height, 0x000000);
-    zbuffer.resize(width * height, 1e9f);
-    if (verbose) std::cout << "Resized to " << width << "x" << height << std::endl;
+    if (!pipelined) {
+        back = (int)(ready.exchange((uint32_t)back | FreshFrame, std::memory_order_acq_rel) & 3);
+        return;
+    }
+    int recorded = back;
+    back = pending < 0 ? 3 : (int)(ready.exchange((uint32_t)pending | FreshFrame, std::memory_order_acq_rel) & 3);
+    pending = recorded;
+    backDepth ^= 1;
+}
+
+// Presenter: swap in the newest finished frame, if one arrived since the last call
+bool Window::AcquireFrontBuffer()
+{
+    if (!(ready.load(std::memory_order_relaxed) & FreshFrame)) return false;
+    front = (int)(ready.exchange((uint32_t)front, std::memory_order_acq_rel) & 3);
+    return true;
 }
 
 void Window::StartRenderLoop(std::function<void()> onFrame)
@@ -98,14 +168,13 @@ void Window::StartRenderLoop(std::function<void()> onFrame)
     renderThread = std::thread([this, onFrame]() {
         while (running)
         {
+            scheduler.BeginFrame();
+            CHOMP_PROFILE_BEGIN_FRAME();
+            PrepareBackBuffer();
             if (onFrame) onFrame();
-#ifdef _WIN32
-            PlatformRender();
-#endif
-#ifdef __APPLE__
-            PlatformRender();
-#endif
-            std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60 FPS
+            PublishFrame();
+            CHOMP_PROFILE_END_FRAME();
+            scheduler.EndFrame(); // sleeps off whatever is left of the frame budget
         }
         });
 }
@@ -116,8 +185,21 @@ void Window::StopRenderLoop()
     if (renderThread.joinable()) renderThread.join();
 }
 
+#if defined(_WIN32) || defined(__APPLE__)
+void Window::Present()
+{
+    CHOMP_PROFILE_SCOPE(ProfileStage::Present);
+    auto start = std::chrono::steady_clock::now();
+    PlatformRender();
+    scheduler.RecordPresent(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+#endif
+
+// Runs on the thread that owns the window, which also presents, so a frame is
+// never drawn to the screen from the render thread
 void Window::ProcessEvents()
 {
+
 #ifdef _WIN32
     MSG msg = {};
     while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
@@ -126,9 +208,11 @@ void Window::ProcessEvents()
         DispatchMessage(&msg);
         if (msg.message == WM_QUIT) running = false;
     }
+    if (AcquireFrontBuffer()) Present();
 #endif
 #ifdef __APPLE__
     // macOS placeholder
+    if (AcquireFrontBuffer()) Present();
 #endif
 }
 
@@ -157,7 +241,7 @@ void Window::InitWindows()
 
     hwnd = CreateWindowEx(0, wc.lpszClassName, title.c_str(),
         WS_OVERLAPPEDWINDOW | WS_VISIBLE,
-        CW_USEDEFAULT, CW_USEDEFAULT, width, height,
+        CW_USEDEFAULT, CW_USEDEFAULT, buffers[0].width, buffers[0].height,
         nullptr, nullptr, hInstance, nullptr);
 
     SetWindowLongPtr((HWND)hwnd, GWLP_USERDATA, (LONG_PTR)this);
@@ -165,20 +249,38 @@ void Window::InitWindows()
 
 void Window::PlatformRender()
 {
+    // the front buffer carries its own size, so a resize mid-flight never mismatches it
+    const FrameBuffer& frame = buffers[front];
     HDC hdc = GetDC((HWND)hwnd);
-    BITMAPINFO bmi = {};
+    struct {
+        BITMAPINFOHEADER bmiHeader;
+        DWORD masks[3]; // channel masks for BI_BITFIELDS
+    } bmi = {};
     bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = width;
-    bmi.bmiHeader.biHeight = -height; // top-down
+    bmi.bmiHeader.biWidth = frame.width;
+    bmi.bmiHeader.biHeight = -frame.height; // top-down
     bmi.bmiHeader.biPlanes = 1;
     bmi.bmiHeader.biBitCount = 32;
     bmi.bmiHeader.biCompression = BI_RGB;
+    const void* bits = frame.pixels.data();
+    int pitch = frame.width; // pixels per DIB row
 
-    {
-        std::lock_guard<std::mutex> lock(bufferMutex);
-        StretchDIBits(hdc, 0, 0, width, height, 0, 0, width, height,
-            framebuffer.data(), &bmi, DIB_RGB_COLORS, SRCCOPY);
+    if (frame.format == ColorFormat::RGB565) {
+        bmi.bmiHeader.biBitCount = 16;
+        bmi.bmiHeader.biCompression = BI_BITFIELDS;
+        bmi.masks[0] = 0xF800; bmi.masks[1] = 0x07E0; bmi.masks[2] = 0x001F;
+        // DIB rows are padded to 4 bytes, which an odd width of 16-bit pixels is not
+        pitch = (frame.width + 1) & ~1;
     }
+    if (frame.layout == TargetLayout::Tiled || pitch != frame.width) {
+        RenderTarget tiles = { (void*)frame.pixels.data(), nullptr, frame.width, frame.height, frame.format, DepthFormat::Float32, frame.layout };
+        resolved.resize(Words((size_t)pitch * frame.height, ColorBytes(frame.format)));
+        ResolveColor(tiles, resolved.data(), pitch, 0, frame.height);
+        bits = resolved.data();
+    }
+
+    StretchDIBits(hdc, 0, 0, frame.width, frame.height, 0, 0, frame.width, frame.height,
+        bits, (const BITMAPINFO*)&bmi, DIB_RGB_COLORS, SRCCOPY);
     ReleaseDC((HWND)hwnd, hdc);
 }
 #endif
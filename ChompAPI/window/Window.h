@@ -4,7 +4,9 @@
 #include <functional>
 #include <thread>
 #include <atomic>
-#include <mutex>
+#include <cstdint>
+#include "FrameScheduler.h"
+#include "../render/TargetFormat.h"
 
 class Window {
 public:
@@ -17,30 +19,75 @@ public:
     void StopRenderLoop();
     void ProcessEvents();
 
-    int* GetFramebuffer();
-    float* GetZBuffer();
+    // The back buffer being rendered and the depth buffer, in the formats last set;
+    // only valid on the render thread inside onFrame
+    RenderTarget GetRenderTarget();
     int GetWidth() const;
     int GetHeight() const;
 
     bool IsRunning() const { return running.load(); }
+    // Records the new size; the back buffer picks it up at the next swap
     void HandleResize(int newW, int newH);
+    // Pixel formats for the frames rendered from the next swap on, XRGB8888 and
+    // Float32 by default. RGB565 with Unorm16 takes half the memory and bandwidth.
+    // A Tiled layout is resolved to rows on the presenting thread.
+    void SetFormats(ColorFormat color, DepthFormat depth, TargetLayout layout = TargetLayout::Linear);
+    // For onFrame drawing through a pipelined RenderPipeline: a frame is presented
+    // once the next one's onFrame returns, since its first Flush finishes the frame
+    // before, and frames alternate between two depth buffers. Set before StartRenderLoop.
+    void SetPipelined(bool on) { pipelined = on; }
 
     bool IsKeyPressed(int key);
 
+    // Frame pacing, 60 fps by default
+    void SetTargetFps(double fps) { scheduler.SetTargetFps(fps); }
+    void SetThroughputMode(bool on) { scheduler.SetThroughputMode(on); }
+    FrameStats GetFrameStats() const { return scheduler.GetStats(); }
+
 private:
-    int width, height;
+    struct FrameBuffer {
+        std::vector<uint32_t> pixels; // PlanePixels of format, rounded up to whole words
+        int width = 0, height = 0;
+        ColorFormat format = ColorFormat::XRGB8888;
+        TargetLayout layout = TargetLayout::Linear;
+    };
+
+    struct DepthBuffer {
+        std::vector<uint32_t> values; // PlanePixels of format, rounded up to whole words
+        DepthFormat format = DepthFormat::Float32;
+    };
+
+    // Triple buffering: the render thread owns buffers[back], the presenter owns
+    // buffers[front], and the third is parked in `ready`. Each side swaps its
+    // buffer with the parked one, so neither ever waits or sees a buffer in use.
+    // Pipelined, the render thread also holds buffers[pending], the frame still
+    // being drawn, and publishes it after the next onFrame.
+    static const uint32_t FreshFrame = 4; // set in `ready` when it holds an unpresented frame
+    FrameBuffer buffers[4];
+    DepthBuffer depths[2]; // only the render thread uses depth; the second when pipelined
+    int back = 0, front = 1, pending = -1;
+    int backDepth = 0;     // of depths, for buffers[back]
+    bool pipelined = false;
+    std::atomic<uint32_t> ready{ 2 };
+    std::atomic<uint64_t> requestedSize; // width << 32 | height
+    std::atomic<uint32_t> requestedFormats; // layout << 16 | color << 8 | depth
+
     std::string title;
-    std::vector<int> framebuffer;
-    std::vector<float> zbuffer;
     bool isMac;
     std::atomic<bool> running;
     std::thread renderThread;
-    mutable std::mutex bufferMutex;
+    FrameScheduler scheduler;
+
+    void PrepareBackBuffer();
+    void PublishFrame();
+    bool AcquireFrontBuffer();
 
 #ifdef _WIN32
     void* hwnd = nullptr;
+    std::vector<uint32_t> resolved; // presenter's rows of a Tiled or odd-width RGB565 frame
     void InitWindows();
     void PlatformRender();
+    void Present();
     void* GetHWND() const;
 #endif
 
@@ -48,5 +95,6 @@ private:
     void* nsWindow = nullptr;
     void InitMac();
     void PlatformRender();
+    void Present();
 #endif
 };